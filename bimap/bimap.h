@@ -1,23 +1,27 @@
 #pragma once
 
+#include "memory_usage_fwd.h"
 #include "nodes.h"
 #include "treap.h"
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
-template <typename L, typename R, typename CL, typename CR>
+template <typename L, typename R, typename CL, typename CR, typename N>
 struct bimap;
 
 namespace iterator {
-template <typename Left, typename Right, typename Tag>
+// Lazy -- узлы lazy_bimap_node, удаленные пары пропускаются
+template <typename Left, typename Right, typename Tag, bool Lazy = false>
 struct bimap_iterator {
   using node_t = base_node;
   using T = typename tags::key<Left, Right, Tag>::type;
   using other_tag = typename tags::other_tag<Tag>::type;
 
-  template <typename L, typename R, typename CL, typename CR>
+  template <typename L, typename R, typename CL, typename CR, typename N>
   friend struct ::bimap;
 
-  friend bimap_iterator<Left, Right, other_tag>;
+  friend bimap_iterator<Left, Right, other_tag, Lazy>;
 
   // Элемент на который сейчас ссылается итератор.
   // Разыменование итератора end_left() неопределено.
@@ -35,7 +39,7 @@ struct bimap_iterator {
   // Инкремент невалидного итератора неопределен.
   bimap_iterator& operator++() {
     ptr = ptr->next();
-    return *this;
+    return skip_dead();
   }
 
   bimap_iterator operator++(int) {
@@ -48,7 +52,9 @@ struct bimap_iterator {
   // Декремент итератора begin_left() неопределен.
   // Декремент невалидного итератора неопределен.
   bimap_iterator& operator--() {
-    ptr = ptr->prev();
+    do {
+      ptr = ptr->prev();
+    } while (is_dead());
     return *this;
   }
 
@@ -71,7 +77,7 @@ struct bimap_iterator {
   // end_left().flip() возращает end_right().
   // end_right().flip() возвращает end_left().
   // flip() невалидного итератора неопределен.
-  bimap_iterator<Left, Right, other_tag> flip() const {
+  bimap_iterator<Left, Right, other_tag, Lazy> flip() const {
     return static_cast<empty_node<other_tag>*>(
         static_cast<base_bimap_node*>(static_cast<empty_node<Tag>*>(ptr)));
   }
@@ -83,19 +89,48 @@ private:
     return casts::down_cast<Left, Right, Tag>(ptr)->template get_value<Tag>();
   }
 
+  // У фиктивного корня (end) нет родителя, у остальных узлов есть
+  bool is_dead() const {
+    if constexpr (Lazy) {
+      return ptr->parent &&
+             static_cast<lazy_bimap_node<Left, Right>*>(
+                 casts::down_cast<Left, Right, Tag>(ptr))
+                 ->dead();
+    } else {
+      return false;
+    }
+  }
+
+  // Пропускает пары, удаленные в ленивом режиме
+  bimap_iterator& skip_dead() {
+    while (is_dead()) {
+      ptr = ptr->next();
+    }
+    return *this;
+  }
+
   bimap_iterator(base_node* n) : ptr(n) {}
 };
 } // namespace iterator
 
+// Node -- тип узла, должен быть наследником bimap_node<Left, Right>
+// (нужен для lru_bimap, который хранит в узле дополнительное звено).
+// Ленивое удаление доступно только с узлами lazy_bimap_node (см. lazy_bimap)
 template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
-          typename CompareRight = std::less<Right>>
+          typename CompareRight = std::less<Right>,
+          typename Node = bimap_node<Left, Right>>
 struct bimap {
   using left_t = Left;
   using right_t = Right;
-  using node_t = bimap_node<left_t, right_t>;
+  using node_t = Node;
 
-  using left_iterator = iterator::bimap_iterator<Left, Right, tags::left_tag>;
-  using right_iterator = iterator::bimap_iterator<Left, Right, tags::right_tag>;
+  static constexpr bool lazy =
+      std::is_base_of_v<lazy_bimap_node<Left, Right>, Node>;
+
+  using left_iterator =
+      iterator::bimap_iterator<Left, Right, tags::left_tag, lazy>;
+  using right_iterator =
+      iterator::bimap_iterator<Left, Right, tags::right_tag, lazy>;
 
   // Создает bimap не содержащий ни одной пары.
   bimap(CompareLeft compare_left = CompareLeft(),
@@ -108,11 +143,13 @@ struct bimap {
     for (auto it = other.begin_left(); it != other.end_left(); ++it) {
       insert(*it, *it.flip());
     }
+    max_dead_ratio_ = other.max_dead_ratio_;
   }
 
   bimap(bimap&& other) noexcept
       : root(std::move(other.root)), left_tree(std::move(other.left_tree)),
-        right_tree(std::move(other.right_tree)), size_(other.size_) {}
+        right_tree(std::move(other.right_tree)), size_(other.size_),
+        dead_(other.dead_), max_dead_ratio_(other.max_dead_ratio_) {}
 
   bimap& operator=(bimap const& other) {
     if (*this != other) {
@@ -134,7 +171,9 @@ struct bimap {
   // Инвалидирует все итераторы ссылающиеся на элементы этого bimap
   // (включая итераторы ссылающиеся на элементы следующие за последними).
   ~bimap() {
-    erase_left(begin_left(), end_left());
+    delete_subtree(left_tree.end()->left);
+    left_tree.end()->left = nullptr;
+    right_tree.end()->left = nullptr;
   }
 
   // Вставка пары (left, right), возвращает итератор на left.
@@ -156,6 +195,89 @@ struct bimap {
     return insert_impl(std::move(left), std::move(right));
   }
 
+  // Вставка набора пар (элементы range -- пары с полями first и second).
+  // Результат тот же, что у вставки по одной в порядке range, но пачка
+  // сортируется, из нее строится декартово дерево за линию, которое
+  // сливается с каждым из деревьев, что для больших пачек сильно быстрее.
+  // Возвращает индексы (в порядке range) пар, которые не были вставлены,
+  // потому что такой left или right уже присутствовал.
+  template <typename Range>
+  std::vector<std::size_t> insert_bulk(Range const& range) {
+    compact();
+    std::vector<std::pair<left_t const*, right_t const*>> items;
+    for (auto const& p : range) {
+      items.emplace_back(&p.first, &p.second);
+    }
+
+    std::vector<std::size_t> by_left(items.size());
+    std::vector<std::size_t> by_right(items.size());
+    for (std::size_t i = 0; i < items.size(); i++) {
+      by_left[i] = by_right[i] = i;
+    }
+    std::stable_sort(by_left.begin(), by_left.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return left_tree.less(*items[a].first, *items[b].first);
+                     });
+    std::stable_sort(
+        by_right.begin(), by_right.end(), [&](std::size_t a, std::size_t b) {
+          return right_tree.less(*items[a].second, *items[b].second);
+        });
+
+    // Номера классов равных ключей, чтобы дубликаты внутри пачки
+    // обрабатывались так же, как при последовательной вставке
+    std::vector<std::size_t> left_group(items.size());
+    std::vector<std::size_t> right_group(items.size());
+    for (std::size_t i = 1; i < items.size(); i++) {
+      left_group[by_left[i]] =
+          left_group[by_left[i - 1]] +
+          !left_tree.equal(*items[by_left[i - 1]].first,
+                           *items[by_left[i]].first);
+      right_group[by_right[i]] =
+          right_group[by_right[i - 1]] +
+          !right_tree.equal(*items[by_right[i - 1]].second,
+                            *items[by_right[i]].second);
+    }
+
+    std::vector<bool> left_taken(items.size()), right_taken(items.size());
+    std::vector<node_t*> nodes(items.size(), nullptr);
+    std::vector<std::size_t> rejected;
+    std::vector<base_node*> left_nodes, right_nodes;
+    left_nodes.reserve(items.size());
+    right_nodes.reserve(items.size());
+    try {
+      for (std::size_t i = 0; i < items.size(); i++) {
+        if (left_taken[left_group[i]] || right_taken[right_group[i]] ||
+            left_tree.find(*items[i].first) ||
+            right_tree.find(*items[i].second)) {
+          rejected.push_back(i);
+          continue;
+        }
+        left_taken[left_group[i]] = right_taken[right_group[i]] = true;
+        nodes[i] = new node_t(*items[i].first, *items[i].second);
+      }
+    } catch (...) {
+      for (node_t* n : nodes) {
+        delete n;
+      }
+      throw;
+    }
+
+    for (std::size_t i = 0; i < items.size(); i++) {
+      if (nodes[by_left[i]]) {
+        left_nodes.push_back(
+            casts::up_cast<Left, Right, tags::left_tag>(nodes[by_left[i]]));
+      }
+      if (nodes[by_right[i]]) {
+        right_nodes.push_back(
+            casts::up_cast<Left, Right, tags::right_tag>(nodes[by_right[i]]));
+      }
+    }
+    left_tree.insert_sorted(left_nodes);
+    right_tree.insert_sorted(right_nodes);
+    size_ += left_nodes.size();
+    return rejected;
+  }
+
   // Удаляет элемент и соответствующий ему парный.
   // erase невалидного итератора неопределен.
   // erase(end_left()) и erase(end_right()) неопределены.
@@ -164,10 +286,7 @@ struct bimap {
   left_iterator erase_left(left_iterator it) {
     auto tmp = it;
     ++tmp;
-    left_tree.erase(it.ptr);
-    right_tree.erase(it.flip().ptr);
-    --size_;
-    delete casts::down_cast<Left, Right, tags::left_tag>(it.ptr);
+    erase_pair(get_node(it));
     return tmp;
   }
 
@@ -185,10 +304,7 @@ struct bimap {
   right_iterator erase_right(right_iterator it) {
     auto tmp = it;
     ++tmp;
-    left_tree.erase(it.flip().ptr);
-    right_tree.erase(it.ptr);
-    --size_;
-    delete casts::down_cast<Left, Right, tags::right_tag>(it.ptr);
+    erase_pair(get_node(it));
     return tmp;
   }
 
@@ -205,18 +321,14 @@ struct bimap {
   // элемент за удаленной последовательностью
   left_iterator erase_left(left_iterator first, left_iterator last) {
     for (auto it = first; it != last;) {
-      auto next = it.ptr->next();
-      erase_left(it);
-      it = next;
+      it = erase_left(it);
     }
     return last;
   }
 
   right_iterator erase_right(right_iterator first, right_iterator last) {
     for (auto it = first; it != last;) {
-      auto next = it.ptr->next();
-      erase_right(it);
-      it = next;
+      it = erase_right(it);
     }
     return last;
   }
@@ -224,12 +336,13 @@ struct bimap {
   // Возвращает итератор по элементу. Если не найден - соответствующий end()
   left_iterator find_left(left_t const& left) const {
     base_node* res = left_tree.find(left);
-    return res ? res : end_left();
+    return res && !is_dead(get_node<tags::left_tag>(res)) ? res : end_left();
   }
 
   right_iterator find_right(right_t const& right) const {
     base_node* res = right_tree.find(right);
-    return res ? res : end_right();
+    return res && !is_dead(get_node<tags::right_tag>(res)) ? res
+                                                           : end_right();
   }
 
   // Возвращает противоположный элемент по элементу
@@ -285,24 +398,24 @@ struct bimap {
   // Возвращают итераторы на соответствующие элементы
   // Смотри std::lower_bound, std::upper_bound.
   left_iterator lower_bound_left(const left_t& left) const {
-    return left_tree.lower_bound(left);
+    return left_iterator(left_tree.lower_bound(left)).skip_dead();
   }
 
   left_iterator upper_bound_left(const left_t& left) const {
-    return left_tree.upper_bound(left);
+    return left_iterator(left_tree.upper_bound(left)).skip_dead();
   }
 
   right_iterator lower_bound_right(const right_t& right) const {
-    return right_tree.lower_bound(right);
+    return right_iterator(right_tree.lower_bound(right)).skip_dead();
   }
 
   right_iterator upper_bound_right(const right_t& right) const {
-    return right_tree.upper_bound(right);
+    return right_iterator(right_tree.upper_bound(right)).skip_dead();
   }
 
   // Возващает итератор на минимальный по порядку left.
   left_iterator begin_left() const {
-    return left_tree.begin();
+    return left_iterator(left_tree.begin()).skip_dead();
   }
 
   // Возващает итератор на следующий за последним по порядку left.
@@ -312,7 +425,7 @@ struct bimap {
 
   // Возващает итератор на минимальный по порядку right.
   right_iterator begin_right() const {
-    return right_tree.begin();
+    return right_iterator(right_tree.begin()).skip_dead();
   }
   // Возващает итератор на следующий за последним по порядку right.
   right_iterator end_right() const {
@@ -329,6 +442,29 @@ struct bimap {
     return size_;
   }
 
+  // Оценка занимаемой памяти: узлы, память ключей в куче (см.
+  // memory::heap_size, без специализации ключи не обходятся) и накладные
+  // расходы аллокатора
+  memory::usage memory_usage() const {
+    memory::usage res;
+    res.nodes = size_ + dead_;
+    res.node_bytes = res.nodes * sizeof(node_t);
+    res.slack_bytes = res.nodes * memory::allocation_slack(sizeof(node_t));
+    if constexpr (memory::has_heap_size<Left> || memory::has_heap_size<Right>) {
+      // удаленные в ленивом режиме пары тоже занимают память
+      for (base_node* n = left_tree.begin(); n != left_tree.end();
+           n = n->next()) {
+        node_t* node = get_node<tags::left_tag>(n);
+        res.heap_bytes +=
+            memory::heap_size<Left>::get(
+                node->template get_value<tags::left_tag>()) +
+            memory::heap_size<Right>::get(
+                node->template get_value<tags::right_tag>());
+      }
+    }
+    return res;
+  }
+
   // операторы сравнения
   friend bool operator==(bimap const& a, bimap const& b) {
     if (a.size() == b.size()) {
@@ -352,27 +488,167 @@ struct bimap {
     left_tree.swap(other.left_tree);
     right_tree.swap(other.right_tree);
     std::swap(size_, other.size_);
+    std::swap(dead_, other.dead_);
+    std::swap(max_dead_ratio_, other.max_dead_ratio_);
+  }
+
+  // Ленивое удаление. erase только помечает пару удаленной, она остается в
+  // деревьях, а поиск и итераторы ее пропускают. Как только доля удаленных
+  // среди всех узлов превышает max_dead_ratio, вызывается compact().
+  // max_dead_ratio = 0 -- обычное удаление (по умолчанию), 1 -- деревья
+  // пересобираются только явным вызовом compact().
+  // Итераторы на неудаленные пары остаются валидными.
+  void set_lazy_erase(double max_dead_ratio)
+    requires lazy
+  {
+    max_dead_ratio_ = max_dead_ratio;
+    if (max_dead_ratio_ <= 0) {
+      compact();
+    }
+  }
+
+  // Удаляет помеченные пары и пересобирает оба дерева за линию
+  void compact() {
+    if (dead_ == 0) {
+      return;
+    }
+    std::vector<base_node*> left_nodes, right_nodes, dead_nodes;
+    left_nodes.reserve(size_);
+    right_nodes.reserve(size_);
+    dead_nodes.reserve(dead_);
+    for (base_node* n = left_tree.begin(); n != left_tree.end();
+         n = n->next()) {
+      (is_dead(get_node<tags::left_tag>(n)) ? dead_nodes : left_nodes)
+          .push_back(n);
+    }
+    for (base_node* n = right_tree.begin(); n != right_tree.end();
+         n = n->next()) {
+      if (!is_dead(get_node<tags::right_tag>(n))) {
+        right_nodes.push_back(n);
+      }
+    }
+    left_tree.rebuild(left_nodes);
+    right_tree.rebuild(right_nodes);
+    for (base_node* n : dead_nodes) {
+      delete get_node<tags::left_tag>(n);
+    }
+    dead_ = 0;
+  }
+
+  // Количество помеченных, но еще не удаленных пар
+  std::size_t dead_count() const {
+    return dead_;
+  }
+
+protected:
+  template <typename Tag>
+  static node_t*
+  get_node(iterator::bimap_iterator<Left, Right, Tag, lazy> it) {
+    return get_node<Tag>(it.ptr);
+  }
+
+  template <typename Tag>
+  static node_t* get_node(base_node* n) {
+    return static_cast<node_t*>(casts::down_cast<Left, Right, Tag>(n));
+  }
+
+  static left_iterator to_iterator(node_t* n) {
+    return casts::up_cast<Left, Right, tags::left_tag>(n);
+  }
+
+  // Физически удаляет узел из деревьев
+  void erase_node(node_t* n) {
+    left_tree.erase(casts::up_cast<Left, Right, tags::left_tag>(n));
+    right_tree.erase(casts::up_cast<Left, Right, tags::right_tag>(n));
+    if (is_dead(n)) {
+      --dead_;
+    } else {
+      --size_;
+    }
+    delete n;
   }
 
 private:
+  static bool is_dead(node_t const* n) {
+    if constexpr (lazy) {
+      return n->dead();
+    } else {
+      return false;
+    }
+  }
+
+  void erase_pair(node_t* n) {
+    if constexpr (lazy) {
+      if (max_dead_ratio_ > 0) {
+        mark_dead(n);
+        return;
+      }
+    }
+    erase_node(n);
+  }
+
+  void mark_dead(node_t* n)
+    requires lazy
+  {
+    n->mark_dead();
+    --size_;
+    ++dead_;
+    if (dead_ > max_dead_ratio_ * (size_ + dead_)) {
+      try {
+        compact();
+      } catch (std::bad_alloc const&) {
+        // не хватило памяти на пересборку, попробуем при следующем erase
+      }
+    }
+  }
+
+  void delete_subtree(base_node* n) {
+    if (n) {
+      delete_subtree(n->left);
+      delete_subtree(n->right);
+      delete get_node<tags::left_tag>(n);
+    }
+  }
+
   template <typename L, typename R>
   left_iterator insert_impl(L&& left, R&& right) {
-    if (find_left(left) == end_left() && find_right(right) == end_right()) {
-      auto* new_node =
-          new node_t(std::forward<L>(left), std::forward<R>(right));
-      base_node* l = casts::up_cast<Left, Right, tags::left_tag>(new_node);
-      base_node* r = casts::up_cast<Left, Right, tags::right_tag>(new_node);
-      left_tree.insert(l);
-      right_tree.insert(r);
-      ++size_;
-      return l;
-    } else {
+    base_node* found_left = left_tree.find(left);
+    base_node* found_right = right_tree.find(right);
+    node_t* dead_left =
+        found_left ? get_node<tags::left_tag>(found_left) : nullptr;
+    node_t* dead_right =
+        found_right ? get_node<tags::right_tag>(found_right) : nullptr;
+    if ((dead_left && !is_dead(dead_left)) ||
+        (dead_right && !is_dead(dead_right))) {
       return end_left();
     }
+    // ключ занят парой, удаленной в ленивом режиме
+    if (dead_left) {
+      erase_node(dead_left);
+    }
+    if (dead_right && dead_right != dead_left) {
+      erase_node(dead_right);
+    }
+
+    auto* new_node = new node_t(std::forward<L>(left), std::forward<R>(right));
+    base_node* l = casts::up_cast<Left, Right, tags::left_tag>(new_node);
+    base_node* r = casts::up_cast<Left, Right, tags::right_tag>(new_node);
+    left_tree.insert(l);
+    right_tree.insert(r);
+    ++size_;
+    return l;
   }
 
   base_bimap_node root;
   tree<left_t, right_t, tags::left_tag, CompareLeft> left_tree;
   tree<left_t, right_t, tags::right_tag, CompareRight> right_tree;
   std::size_t size_;
+  std::size_t dead_{0};
+  double max_dead_ratio_{0};
 };
+
+// bimap с ленивым удалением (set_lazy_erase)
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>>
+using lazy_bimap = bimap<Left, Right, CompareLeft, CompareRight,
+                         lazy_bimap_node<Left, Right>>;
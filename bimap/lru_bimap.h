@@ -0,0 +1,171 @@
+#pragma once
+
+#include "bimap.h"
+
+// bimap ограниченной вместимости. При вставке новой пары в заполненный
+// lru_bimap удаляется пара, которая дольше всех не использовалась.
+// Порядок использования хранится в самих узлах (recency_link), поэтому
+// никаких дополнительных аллокаций нет.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>>
+struct lru_bimap : private bimap<Left, Right, CompareLeft, CompareRight,
+                                 lru_bimap_node<Left, Right>> {
+private:
+  using base = bimap<Left, Right, CompareLeft, CompareRight,
+                     lru_bimap_node<Left, Right>>;
+  using typename base::node_t;
+
+public:
+  using typename base::left_iterator;
+  using typename base::left_t;
+  using typename base::right_iterator;
+  using typename base::right_t;
+
+  explicit lru_bimap(std::size_t capacity,
+                     CompareLeft compare_left = CompareLeft(),
+                     CompareRight compare_right = CompareRight())
+      : base(std::move(compare_left), std::move(compare_right)),
+        capacity_(capacity) {}
+
+  // Копия сохраняет порядок использования
+  lru_bimap(lru_bimap const& other) : lru_bimap(other.capacity_) {
+    for (recency_link* l = other.recent.prev; l != &other.recent; l = l->prev) {
+      auto* n = static_cast<node_t const*>(l);
+      insert(n->template get_value<tags::left_tag>(),
+             n->template get_value<tags::right_tag>());
+    }
+  }
+
+  lru_bimap& operator=(lru_bimap const& other) {
+    if (this != &other) {
+      lru_bimap tmp(other);
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  // Вставка пары (left, right), возвращает итератор на left.
+  // Новая пара становится самой свежей. Если lru_bimap был заполнен, после
+  // вставки удаляется самая старая пара; если вставка бросила исключение,
+  // lru_bimap не меняется.
+  // Если такой left или такой right уже присутствуют, вставка не производится,
+  // ничего не удаляется и возвращается end_left().
+  left_iterator insert(left_t const& left, right_t const& right) {
+    return insert_impl(left, right);
+  }
+
+  left_iterator insert(left_t const& left, right_t&& right) {
+    return insert_impl(left, std::move(right));
+  }
+
+  left_iterator insert(left_t&& left, right_t const& right) {
+    return insert_impl(std::move(left), right);
+  }
+
+  left_iterator insert(left_t&& left, right_t&& right) {
+    return insert_impl(std::move(left), std::move(right));
+  }
+
+  // Поиск, найденная пара становится самой свежей
+  left_iterator find_left(left_t const& left) {
+    left_iterator res = base::find_left(left);
+    if (res != end_left()) {
+      touch(base::get_node(res));
+    }
+    return res;
+  }
+
+  right_iterator find_right(right_t const& right) {
+    right_iterator res = base::find_right(right);
+    if (res != end_right()) {
+      touch(base::get_node(res));
+    }
+    return res;
+  }
+
+  right_t const& at_left(left_t const& key) {
+    left_iterator res = find_left(key);
+    if (res == end_left()) {
+      throw std::out_of_range("Not found key");
+    }
+    return *res.flip();
+  }
+
+  left_t const& at_right(right_t const& key) {
+    right_iterator res = find_right(key);
+    if (res == end_right()) {
+      throw std::out_of_range("Not found key");
+    }
+    return *res.flip();
+  }
+
+  // Самая старая пара, end_left() если lru_bimap пуст
+  left_iterator oldest_left() const {
+    if (empty()) {
+      return end_left();
+    }
+    return base::to_iterator(static_cast<node_t*>(recent.prev));
+  }
+
+  // Остальное -- как у bimap, порядок использования не меняется
+  using base::erase_left;
+  using base::erase_right;
+
+  using base::lower_bound_left;
+  using base::lower_bound_right;
+  using base::upper_bound_left;
+  using base::upper_bound_right;
+
+  using base::begin_left;
+  using base::begin_right;
+  using base::end_left;
+  using base::end_right;
+
+  using base::empty;
+  using base::memory_usage;
+  using base::size;
+
+  std::size_t capacity() const {
+    return capacity_;
+  }
+
+  void swap(lru_bimap& other) {
+    base::swap(other);
+    std::swap(capacity_, other.capacity_);
+    // звенья узлов ссылаются на голову списка, поэтому меняем их содержимое
+    recency_link tmp;
+    tmp.link_before(&recent);
+    recent.unlink();
+    recent.link_before(&other.recent);
+    other.recent.unlink();
+    other.recent.link_before(&tmp);
+  }
+
+private:
+  template <typename L, typename R>
+  left_iterator insert_impl(L&& left, R&& right) {
+    if (capacity_ == 0) {
+      return end_left();
+    }
+    left_iterator res = base::insert(std::forward<L>(left),
+                                     std::forward<R>(right));
+    if (res == end_left()) {
+      return res;
+    }
+    // новый узел еще не в списке использования, поэтому не удалится
+    if (size() > capacity_) {
+      base::erase_node(static_cast<node_t*>(recent.prev));
+    }
+    touch(base::get_node(res));
+    return res;
+  }
+
+  void touch(node_t* n) {
+    n->unlink();
+    n->link_before(recent.next);
+  }
+
+  // recent.next -- самая свежая пара, recent.prev -- самая старая
+  recency_link recent;
+  std::size_t capacity_;
+};
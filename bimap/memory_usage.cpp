@@ -0,0 +1,87 @@
+#include "memory_usage.h"
+
+std::size_t memory::usage::total() const {
+  return node_bytes + heap_bytes + slack_bytes;
+}
+
+memory::usage& memory::usage::operator+=(usage const& other) {
+  nodes += other.nodes;
+  node_bytes += other.node_bytes;
+  heap_bytes += other.heap_bytes;
+  slack_bytes += other.slack_bytes;
+  return *this;
+}
+
+std::size_t memory::allocation_slack(std::size_t size) {
+  constexpr std::size_t word = sizeof(void*);
+  std::size_t chunk = (size + word + 2 * word - 1) / (2 * word) * (2 * word);
+  return chunk - size;
+}
+
+memory::registry::handle::handle(registry* r, std::size_t id)
+    : owner(r), id(id) {}
+
+memory::registry::handle::handle(handle&& other) noexcept
+    : owner(other.owner), id(other.id) {
+  other.owner = nullptr;
+}
+
+memory::registry::handle&
+memory::registry::handle::operator=(handle&& other) noexcept {
+  if (this != &other) {
+    reset();
+    owner = other.owner;
+    id = other.id;
+    other.owner = nullptr;
+  }
+  return *this;
+}
+
+memory::registry::handle::~handle() {
+  reset();
+}
+
+void memory::registry::handle::reset() {
+  if (owner) {
+    owner->remove(id);
+    owner = nullptr;
+  }
+}
+
+memory::registry& memory::registry::instance() {
+  static registry r;
+  return r;
+}
+
+memory::usage memory::registry::total() const {
+  std::lock_guard lg(m);
+  usage res;
+  for (auto const& [id, e] : entries) {
+    res += e.report();
+  }
+  return res;
+}
+
+std::vector<std::pair<std::string, memory::usage>>
+memory::registry::snapshot() const {
+  std::lock_guard lg(m);
+  std::vector<std::pair<std::string, usage>> res;
+  res.reserve(entries.size());
+  for (auto const& [id, e] : entries) {
+    res.emplace_back(e.name, e.report());
+  }
+  return res;
+}
+
+memory::registry::handle
+memory::registry::add_impl(std::string name, std::function<usage()> report) {
+  std::lock_guard lg(m);
+  std::size_t id = next_id++;
+  entries.emplace(id, entry{std::move(name), std::move(report)});
+  return handle(this, id);
+}
+
+void memory::registry::remove(std::size_t id) {
+  std::lock_guard lg(m);
+  entries.erase(id);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "memory_usage_fwd.h"
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace memory {
+// Реестр на весь процесс, в котором можно зарегистрировать bimap'ы, чтобы
+// выгружать суммарное потребление памяти в метрики. Регистрация явная,
+// незарегистрированные bimap ничего не платят.
+// Отчет строится в вызывающем потоке, синхронизацию с изменениями
+// зарегистрированных bimap обеспечивает пользователь.
+class registry {
+public:
+  // Снимает регистрацию в деструкторе
+  class handle {
+  public:
+    handle() = default;
+    handle(handle const&) = delete;
+    handle(handle&& other) noexcept;
+    handle& operator=(handle const&) = delete;
+    handle& operator=(handle&& other) noexcept;
+    ~handle();
+
+    void reset();
+
+  private:
+    friend class registry;
+
+    handle(registry* r, std::size_t id);
+
+    registry* owner{nullptr};
+    std::size_t id{0};
+  };
+
+  static registry& instance();
+
+  // Map -- любой тип с методом memory_usage(). Map должен жить дольше handle
+  // и не перемещаться, пока зарегистрирован.
+  template <typename Map>
+  [[nodiscard]] handle add(std::string name, Map const& map) {
+    return add_impl(std::move(name), [&map] { return map.memory_usage(); });
+  }
+
+  usage total() const;
+  std::vector<std::pair<std::string, usage>> snapshot() const;
+
+private:
+  struct entry {
+    std::string name;
+    std::function<usage()> report;
+  };
+
+  handle add_impl(std::string name, std::function<usage()> report);
+  void remove(std::size_t id);
+
+  mutable std::mutex m;
+  std::map<std::size_t, entry> entries;
+  std::size_t next_id{0};
+};
+} // namespace memory
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Все, что нужно bimap::memory_usage(). Реестр (memory::registry) с его
+// зависимостями -- в memory_usage.h, его подключают только те, кто
+// регистрирует bimap'ы
+
+namespace memory {
+// Оценка памяти, занимаемой bimap
+struct usage {
+  std::size_t nodes{0};
+  // nodes * sizeof(узла)
+  std::size_t node_bytes{0};
+  // память в куче, которой владеют сами ключи (см. heap_size)
+  std::size_t heap_bytes{0};
+  // оценка накладных расходов аллокатора на узлы
+  std::size_t slack_bytes{0};
+
+  std::size_t total() const;
+  usage& operator+=(usage const& other);
+};
+
+// Оценка памяти в куче, которой владеет ключ. По умолчанию 0, для своих типов
+// можно специализировать (нужна static std::size_t get(T const&)).
+template <typename T>
+struct heap_size {
+  static constexpr bool trivial = true;
+
+  static std::size_t get(T const&) {
+    return 0;
+  }
+};
+
+template <typename C, typename Traits, typename A>
+struct heap_size<std::basic_string<C, Traits, A>> {
+  static std::size_t get(std::basic_string<C, Traits, A> const& s) {
+    auto const* begin = reinterpret_cast<char const*>(&s);
+    auto const* data = reinterpret_cast<char const*>(s.data());
+    // короткая строка лежит внутри объекта
+    if (begin <= data && data < begin + sizeof(s)) {
+      return 0;
+    }
+    return (s.capacity() + 1) * sizeof(C);
+  }
+};
+
+template <typename T, typename A>
+struct heap_size<std::vector<T, A>> {
+  static std::size_t get(std::vector<T, A> const& v) {
+    std::size_t res = v.capacity() * sizeof(T);
+    for (T const& x : v) {
+      res += heap_size<T>::get(x);
+    }
+    return res;
+  }
+};
+
+template <typename T>
+constexpr inline bool has_heap_size = !requires { heap_size<T>::trivial; };
+
+// Оценка накладных расходов malloc на блок размера size: заголовок в одно
+// слово и выравнивание до двух слов, как в glibc
+std::size_t allocation_slack(std::size_t size);
+} // namespace memory
@@ -38,3 +38,20 @@ void base_node::update_children_links() {
     right->parent = this;
   }
 }
+
+void recency_link::unlink() {
+  prev->next = next;
+  next->prev = prev;
+  prev = next = this;
+}
+
+void recency_link::link_before(recency_link* pos) {
+  prev = pos->prev;
+  next = pos;
+  prev->next = this;
+  pos->prev = this;
+}
+
+recency_link::~recency_link() {
+  unlink();
+}
@@ -67,7 +67,7 @@ struct bimap_node : base_bimap_node {
   template <typename L, typename R>
   bimap_node(L&& left, R&& right)
       : left_value(std::forward<L>(left)), right_value(std::forward<R>(right)),
-        priority(generator::gen()) {}
+        priority(generator::gen() >> 1) {}
 
   template <typename Tag,
             std::enable_if_t<std::is_same_v<Tag, tags::left_tag>, bool> = true>
@@ -91,7 +91,50 @@ private:
 
   // Для разных деревьев можно делать одинаковый приоритет, это ничего не
   // испортит
-  uint32_t priority;
+  uint32_t priority : 31;
+
+protected:
+  // Свободный бит рядом с приоритетом, см. lazy_bimap_node
+  uint32_t spare_bit : 1 = 0;
+};
+
+// Узел bimap с ленивым удалением (см. bimap::set_lazy_erase). Отметка
+// хранится в свободном бите приоритета, поэтому узел не больше bimap_node, а
+// bimap с обычными узлами ее не проверяет.
+template <typename Left, typename Right>
+struct lazy_bimap_node : bimap_node<Left, Right> {
+  using bimap_node<Left, Right>::bimap_node;
+
+  // Пара удалена, но еще лежит в деревьях
+  bool dead() const {
+    return this->spare_bit;
+  }
+
+  void mark_dead() {
+    this->spare_bit = 1;
+  }
+};
+
+// Звено интрузивного кольцевого списка, по нему lru_bimap хранит порядок
+// использования пар. Пустое звено ссылается само на себя, при удалении
+// звено само выписывается из списка.
+struct recency_link {
+  recency_link() = default;
+  recency_link(recency_link const&) = delete;
+  recency_link& operator=(recency_link const&) = delete;
+  ~recency_link();
+
+  void unlink();
+  // вставляет this перед pos
+  void link_before(recency_link* pos);
+
+  recency_link* prev{this};
+  recency_link* next{this};
+};
+
+template <typename Left, typename Right>
+struct lru_bimap_node : bimap_node<Left, Right>, recency_link {
+  using bimap_node<Left, Right>::bimap_node;
 };
 
 namespace casts {
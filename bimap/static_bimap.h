@@ -0,0 +1,276 @@
+#pragma once
+
+#include "nodes.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+// Неизменяемый bimap, который целиком строится во время компиляции:
+//   constexpr auto opcodes = make_static_bimap<int, std::string_view>({
+//       {0x01, "nop"}, {0x02, "push"}, {0x03, "pop"}});
+// Пары хранятся в массиве, отсортированном по left, плюс две перестановки
+// для порядка по right, поиск -- бинарный. Никаких аллокаций и
+// инициализации во время выполнения, объект может лежать в read-only памяти.
+template <typename Left, typename Right, std::size_t N,
+          typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>>
+struct static_bimap;
+
+namespace iterator {
+template <typename Map, typename Tag>
+struct static_bimap_iterator {
+  using T = typename tags::key<typename Map::left_t, typename Map::right_t,
+                               Tag>::type;
+  using other_tag = typename tags::other_tag<Tag>::type;
+
+  friend Map;
+  friend static_bimap_iterator<Map, other_tag>;
+
+  constexpr T const& operator*() const {
+    return map->template get_value<Tag>(pos);
+  }
+
+  constexpr T const* operator->() const {
+    return &**this;
+  }
+
+  constexpr static_bimap_iterator& operator++() {
+    ++pos;
+    return *this;
+  }
+
+  constexpr static_bimap_iterator operator++(int) {
+    static_bimap_iterator res(*this);
+    ++(*this);
+    return res;
+  }
+
+  constexpr static_bimap_iterator& operator--() {
+    --pos;
+    return *this;
+  }
+
+  constexpr static_bimap_iterator operator--(int) {
+    static_bimap_iterator res(*this);
+    --(*this);
+    return res;
+  }
+
+  friend constexpr bool operator==(static_bimap_iterator const& lhs,
+                                   static_bimap_iterator const& rhs) {
+    return lhs.pos == rhs.pos;
+  }
+
+  friend constexpr bool operator!=(static_bimap_iterator const& lhs,
+                                   static_bimap_iterator const& rhs) {
+    return lhs.pos != rhs.pos;
+  }
+
+  // Итератор на парный элемент, end().flip() -- end() другой стороны
+  constexpr static_bimap_iterator<Map, other_tag> flip() const {
+    return {map, map->template flip_pos<Tag>(pos)};
+  }
+
+private:
+  Map const* map;
+  std::size_t pos;
+
+  constexpr static_bimap_iterator(Map const* m, std::size_t p)
+      : map(m), pos(p) {}
+};
+} // namespace iterator
+
+template <typename Left, typename Right, std::size_t N, typename CompareLeft,
+          typename CompareRight>
+struct static_bimap {
+  using left_t = Left;
+  using right_t = Right;
+  using value_type = std::pair<Left, Right>;
+
+  using left_iterator =
+      iterator::static_bimap_iterator<static_bimap, tags::left_tag>;
+  using right_iterator =
+      iterator::static_bimap_iterator<static_bimap, tags::right_tag>;
+
+  // Повторяющиеся left или right -- ошибка компиляции при constexpr
+  // построении (и std::invalid_argument во время выполнения)
+  constexpr explicit static_bimap(value_type const (&pairs)[N],
+                                  CompareLeft compare_left = CompareLeft(),
+                                  CompareRight compare_right = CompareRight())
+      : compare_left(std::move(compare_left)),
+        compare_right(std::move(compare_right)), data(std::to_array(pairs)),
+        by_right(), right_pos() {
+    std::sort(data.begin(), data.end(),
+              [this](value_type const& a, value_type const& b) {
+                return this->compare_left(a.first, b.first);
+              });
+    for (std::size_t i = 0; i < N; i++) {
+      by_right[i] = i;
+    }
+    std::sort(by_right.begin(), by_right.end(),
+              [this](std::size_t a, std::size_t b) {
+                return this->compare_right(data[a].second, data[b].second);
+              });
+    for (std::size_t i = 0; i < N; i++) {
+      right_pos[by_right[i]] = i;
+    }
+    for (std::size_t i = 1; i < N; i++) {
+      if (!this->compare_left(data[i - 1].first, data[i].first) ||
+          !this->compare_right(data[by_right[i - 1]].second,
+                               data[by_right[i]].second)) {
+        throw std::invalid_argument("Duplicate key in static_bimap");
+      }
+    }
+  }
+
+  // Возвращает итератор по элементу. Если не найден - соответствующий end()
+  constexpr left_iterator find_left(left_t const& left) const {
+    left_iterator res = lower_bound_left(left);
+    if (res != end_left() && !compare_left(left, *res)) {
+      return res;
+    }
+    return end_left();
+  }
+
+  constexpr right_iterator find_right(right_t const& right) const {
+    right_iterator res = lower_bound_right(right);
+    if (res != end_right() && !compare_right(right, *res)) {
+      return res;
+    }
+    return end_right();
+  }
+
+  // Если элемента не существует -- бросает std::out_of_range
+  constexpr right_t const& at_left(left_t const& key) const {
+    left_iterator res = find_left(key);
+    if (res == end_left()) {
+      throw std::out_of_range("Not found key");
+    }
+    return *res.flip();
+  }
+
+  constexpr left_t const& at_right(right_t const& key) const {
+    right_iterator res = find_right(key);
+    if (res == end_right()) {
+      throw std::out_of_range("Not found key");
+    }
+    return *res.flip();
+  }
+
+  constexpr left_iterator lower_bound_left(left_t const& left) const {
+    return bound_left<false>(left);
+  }
+
+  constexpr left_iterator upper_bound_left(left_t const& left) const {
+    return bound_left<true>(left);
+  }
+
+  constexpr right_iterator lower_bound_right(right_t const& right) const {
+    return bound_right<false>(right);
+  }
+
+  constexpr right_iterator upper_bound_right(right_t const& right) const {
+    return bound_right<true>(right);
+  }
+
+  constexpr left_iterator begin_left() const {
+    return {this, 0};
+  }
+
+  constexpr left_iterator end_left() const {
+    return {this, N};
+  }
+
+  constexpr right_iterator begin_right() const {
+    return {this, 0};
+  }
+
+  constexpr right_iterator end_right() const {
+    return {this, N};
+  }
+
+  constexpr bool empty() const {
+    return N == 0;
+  }
+
+  constexpr std::size_t size() const {
+    return N;
+  }
+
+private:
+  friend left_iterator;
+  friend right_iterator;
+
+  template <typename Tag,
+            std::enable_if_t<std::is_same_v<Tag, tags::left_tag>, bool> = true>
+  constexpr Left const& get_value(std::size_t pos) const {
+    return data[pos].first;
+  }
+
+  template <typename Tag,
+            std::enable_if_t<std::is_same_v<Tag, tags::right_tag>, bool> = true>
+  constexpr Right const& get_value(std::size_t pos) const {
+    return data[by_right[pos]].second;
+  }
+
+  template <typename Tag>
+  constexpr std::size_t flip_pos(std::size_t pos) const {
+    if (pos == N) {
+      return N;
+    }
+    if constexpr (std::is_same_v<Tag, tags::left_tag>) {
+      return right_pos[pos];
+    } else {
+      return by_right[pos];
+    }
+  }
+
+  template <bool Upper>
+  constexpr left_iterator bound_left(left_t const& left) const {
+    auto comp = [this](value_type const& a, left_t const& b) {
+      if constexpr (Upper) {
+        return !compare_left(b, a.first);
+      } else {
+        return compare_left(a.first, b);
+      }
+    };
+    return {this, static_cast<std::size_t>(
+                      std::lower_bound(data.begin(), data.end(), left, comp) -
+                      data.begin())};
+  }
+
+  template <bool Upper>
+  constexpr right_iterator bound_right(right_t const& right) const {
+    auto comp = [this](std::size_t a, right_t const& b) {
+      if constexpr (Upper) {
+        return !compare_right(b, data[a].second);
+      } else {
+        return compare_right(data[a].second, b);
+      }
+    };
+    return {this, static_cast<std::size_t>(
+                      std::lower_bound(by_right.begin(), by_right.end(), right,
+                                       comp) -
+                      by_right.begin())};
+  }
+
+  [[no_unique_address]] CompareLeft compare_left;
+  [[no_unique_address]] CompareRight compare_right;
+  // отсортирован по left
+  std::array<value_type, N> data;
+  // by_right[i] -- индекс в data i-й по порядку пары по right,
+  // right_pos -- обратная перестановка
+  std::array<std::size_t, N> by_right;
+  std::array<std::size_t, N> right_pos;
+};
+
+template <typename Left, typename Right,
+          typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>, std::size_t N>
+constexpr static_bimap<Left, Right, N, CompareLeft, CompareRight>
+make_static_bimap(std::pair<Left, Right> const (&pairs)[N],
+                  CompareLeft compare_left = CompareLeft(),
+                  CompareRight compare_right = CompareRight()) {
+  return static_bimap<Left, Right, N, CompareLeft, CompareRight>(
+      pairs, std::move(compare_left), std::move(compare_right));
+}
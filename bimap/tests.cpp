@@ -1,6 +1,11 @@
 #include <random>
+#include <string>
+#include <string_view>
 
 #include "bimap.h"
+#include "lru_bimap.h"
+#include "memory_usage.h"
+#include "static_bimap.h"
 #include "test-classes.h"
 
 TEST(bimap, leak_check) {
@@ -589,3 +594,336 @@ TEST(bimap_randomized, compare_to_two_maps) {
   std::cout << "Performed " << ins << " insertions and " << total - ins - skip
             << " erasures. " << skip << " skipped." << std::endl;
 }
+
+TEST(lru_bimap, eviction) {
+  lru_bimap<int, int> b(3);
+  b.insert(1, 10);
+  b.insert(2, 20);
+  b.insert(3, 30);
+  EXPECT_EQ(b.size(), 3);
+  EXPECT_EQ(*b.oldest_left(), 1);
+
+  b.insert(4, 40);
+  EXPECT_EQ(b.size(), 3);
+  EXPECT_EQ(b.find_left(1), b.end_left());
+  EXPECT_EQ(b.find_right(10), b.end_right());
+  EXPECT_EQ(*b.oldest_left(), 2);
+}
+
+TEST(lru_bimap, find_refreshes) {
+  lru_bimap<int, int> b(3);
+  b.insert(1, 10);
+  b.insert(2, 20);
+  b.insert(3, 30);
+
+  EXPECT_EQ(*b.find_left(1).flip(), 10);
+  EXPECT_EQ(b.at_right(20), 2);
+  b.insert(4, 40);
+  EXPECT_EQ(b.find_left(3), b.end_left());
+  EXPECT_EQ(b.at_left(1), 10);
+  EXPECT_EQ(b.at_left(2), 20);
+  EXPECT_EQ(b.at_left(4), 40);
+  EXPECT_THROW(b.at_left(3), std::out_of_range);
+}
+
+TEST(lru_bimap, insert_exist_no_eviction) {
+  lru_bimap<int, int> b(2);
+  b.insert(1, 10);
+  b.insert(2, 20);
+  EXPECT_EQ(b.insert(1, 30), b.end_left());
+  EXPECT_EQ(b.insert(3, 20), b.end_left());
+  EXPECT_EQ(b.size(), 2);
+  EXPECT_EQ(*b.oldest_left(), 1);
+}
+
+TEST(lru_bimap, insert_throws_no_eviction) {
+  {
+    lru_bimap<address_checking_object, int> b(2);
+    b.insert(1, 10);
+    b.insert(2, 20);
+    address_checking_object key(3);
+    address_checking_object::set_copy_throw_countdown(1);
+    EXPECT_THROW(b.insert(key, 30), std::runtime_error);
+    address_checking_object::set_copy_throw_countdown(0);
+    EXPECT_EQ(b.size(), 2);
+    EXPECT_EQ(*b.oldest_left(), 1);
+  }
+  address_checking_object::expect_no_instances();
+}
+
+TEST(lru_bimap, erase) {
+  lru_bimap<int, int> b(3);
+  b.insert(1, 10);
+  b.insert(2, 20);
+  b.insert(3, 30);
+  EXPECT_TRUE(b.erase_left(1));
+  EXPECT_TRUE(b.erase_right(30));
+  EXPECT_EQ(*b.oldest_left(), 2);
+  b.insert(4, 40);
+  b.insert(5, 50);
+  b.insert(6, 60);
+  EXPECT_EQ(b.size(), 3);
+  EXPECT_EQ(b.find_left(2), b.end_left());
+  b.erase_left(b.begin_left(), b.end_left());
+  EXPECT_TRUE(b.empty());
+  EXPECT_EQ(b.oldest_left(), b.end_left());
+}
+
+TEST(lru_bimap, copy_and_swap) {
+  lru_bimap<int, int> a(3);
+  a.insert(1, 10);
+  a.insert(2, 20);
+  a.insert(3, 30);
+  a.find_left(1);
+
+  lru_bimap<int, int> b(a);
+  EXPECT_EQ(*b.oldest_left(), 2);
+
+  lru_bimap<int, int> c(5);
+  c.insert(7, 70);
+  c.swap(b);
+  EXPECT_EQ(c.capacity(), 3);
+  EXPECT_EQ(b.capacity(), 5);
+  EXPECT_EQ(*c.oldest_left(), 2);
+  EXPECT_EQ(*b.oldest_left(), 7);
+  c.insert(4, 40);
+  EXPECT_EQ(c.find_left(2), c.end_left());
+}
+
+TEST(lru_bimap_randomized, leak_check) {
+  lru_bimap<address_checking_object, int> b(100);
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 10000; i++) {
+    b.insert(static_cast<int>(e() % 1000), static_cast<int>(e() % 1000));
+    b.find_left(static_cast<int>(e() % 1000));
+    EXPECT_LE(b.size(), 100);
+  }
+}
+
+namespace {
+constexpr auto opcodes = make_static_bimap<int, std::string_view>(
+    {{3, "pop"}, {1, "nop"}, {2, "push"}, {10, "add"}});
+
+static_assert(opcodes.size() == 4);
+static_assert(opcodes.at_left(2) == "push");
+static_assert(opcodes.at_right("add") == 10);
+static_assert(opcodes.find_left(4) == opcodes.end_left());
+static_assert(*opcodes.begin_left() == 1);
+static_assert(*opcodes.begin_right() == "add");
+} // namespace
+
+TEST(static_bimap, find) {
+  EXPECT_EQ(*opcodes.find_left(3).flip(), "pop");
+  EXPECT_EQ(*opcodes.find_right("nop").flip(), 1);
+  EXPECT_EQ(opcodes.find_right("mul"), opcodes.end_right());
+  EXPECT_THROW(opcodes.at_left(42), std::out_of_range);
+  EXPECT_EQ(opcodes.end_left().flip(), opcodes.end_right());
+  EXPECT_EQ(opcodes.end_right().flip(), opcodes.end_left());
+}
+
+TEST(static_bimap, iterating) {
+  std::vector<int> lefts;
+  for (auto it = opcodes.begin_left(); it != opcodes.end_left(); ++it) {
+    lefts.push_back(*it);
+    EXPECT_EQ(*it.flip().flip(), *it);
+  }
+  EXPECT_EQ(lefts, std::vector<int>({1, 2, 3, 10}));
+
+  std::vector<std::string_view> rights;
+  for (auto it = opcodes.end_right(); it != opcodes.begin_right();) {
+    rights.push_back(*--it);
+  }
+  EXPECT_EQ(rights,
+            std::vector<std::string_view>({"push", "pop", "nop", "add"}));
+}
+
+TEST(static_bimap, bounds) {
+  constexpr auto b = make_static_bimap<int, int, std::greater<>>(
+      {{1, 4}, {5, 2}, {3, 8}});
+  static_assert(*b.lower_bound_left(4) == 3);
+  static_assert(*b.upper_bound_left(3) == 1);
+  static_assert(*b.lower_bound_right(3) == 4);
+  static_assert(*b.upper_bound_right(4) == 8);
+  EXPECT_EQ(b.upper_bound_right(8), b.end_right());
+}
+
+TEST(static_bimap, duplicates) {
+  using pair = std::pair<int, int>;
+  pair pairs[] = {{1, 2}, {3, 2}};
+  EXPECT_THROW((static_bimap<int, int, 2>(pairs)), std::invalid_argument);
+}
+
+TEST(bimap, insert_bulk) {
+  bimap<int, int> b;
+  b.insert(5, 50);
+  std::vector<std::pair<int, int>> batch = {
+      {3, 30}, {1, 10}, {5, 7}, {2, 50}, {1, 20}, {4, 10}, {4, 40}, {6, 60}};
+  EXPECT_EQ(b.insert_bulk(batch), std::vector<std::size_t>({2, 3, 4, 5}));
+  EXPECT_EQ(b.size(), 5);
+
+  std::vector<int> lefts;
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    lefts.push_back(*it);
+    EXPECT_EQ(*it * 10, *it.flip());
+  }
+  EXPECT_EQ(lefts, std::vector<int>({1, 3, 4, 5, 6}));
+}
+
+TEST(bimap_randomized, insert_bulk_vs_insert) {
+  std::mt19937 e(seed);
+  for (size_t iter = 0; iter < 20; iter++) {
+    bimap<int, int> a, b;
+    for (size_t i = 0; i < 1000; i++) {
+      int l = static_cast<int>(e() % 3000), r = static_cast<int>(e() % 3000);
+      a.insert(l, r);
+      b.insert(l, r);
+    }
+    std::vector<std::pair<int, int>> batch(5000);
+    for (auto& p : batch) {
+      p = {static_cast<int>(e() % 6000), static_cast<int>(e() % 6000)};
+    }
+    std::vector<std::size_t> rejected;
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      if (a.insert(batch[i].first, batch[i].second) == a.end_left()) {
+        rejected.push_back(i);
+      }
+    }
+    EXPECT_EQ(b.insert_bulk(batch), rejected);
+    EXPECT_EQ(a, b);
+    for (auto it = b.begin_right(); it != b.end_right(); ++it) {
+      EXPECT_EQ(b.find_left(*it.flip()).flip(), it);
+    }
+  }
+}
+
+TEST(bimap, memory_usage) {
+  bimap<int, std::string> b;
+  EXPECT_EQ(b.memory_usage().total(), 0);
+
+  b.insert(1, "short");
+  b.insert(2, std::string(100, 'x'));
+  memory::usage u = b.memory_usage();
+  EXPECT_EQ(u.nodes, 2);
+  EXPECT_EQ(u.node_bytes, 2 * sizeof(bimap_node<int, std::string>));
+  EXPECT_GE(u.heap_bytes, 101);
+  EXPECT_LT(u.heap_bytes, 1000);
+  EXPECT_EQ(u.total(), u.node_bytes + u.heap_bytes + u.slack_bytes);
+}
+
+TEST(bimap, memory_registry) {
+  auto& r = memory::registry::instance();
+  std::size_t before = r.total().nodes;
+  bimap<int, int> a;
+  lru_bimap<int, int> b(10);
+  a.insert(1, 2);
+  b.insert(3, 4);
+  b.insert(5, 6);
+  {
+    auto ha = r.add("a", a);
+    auto hb = r.add("b", b);
+    EXPECT_EQ(r.total().nodes, before + 3);
+    EXPECT_EQ(r.snapshot().size(), 2);
+    ha.reset();
+    EXPECT_EQ(r.total().nodes, before + 2);
+  }
+  EXPECT_EQ(r.total().nodes, before);
+}
+
+// Отметка удаления не увеличивает узел, а обычный bimap ее не видит
+static_assert(sizeof(lazy_bimap_node<char, char>) ==
+              sizeof(bimap_node<char, char>));
+template <typename Map>
+concept has_lazy_erase = requires(Map m) { m.set_lazy_erase(1); };
+static_assert(has_lazy_erase<lazy_bimap<int, int>>);
+static_assert(!has_lazy_erase<bimap<int, int>>);
+
+TEST(bimap, lazy_erase) {
+  lazy_bimap<int, int> b;
+  b.set_lazy_erase(1);
+  for (int i = 0; i < 10; i++) {
+    b.insert(i, -i);
+  }
+  auto it = b.find_left(5);
+  EXPECT_TRUE(b.erase_left(4));
+  EXPECT_TRUE(b.erase_right(-6));
+  EXPECT_EQ(b.erase_left(b.find_left(0)), b.find_left(1));
+  EXPECT_EQ(b.size(), 7);
+  EXPECT_EQ(b.dead_count(), 3);
+  EXPECT_EQ(b.memory_usage().nodes, 10);
+
+  EXPECT_EQ(b.find_left(4), b.end_left());
+  EXPECT_EQ(b.find_right(-6), b.end_right());
+  EXPECT_EQ(*b.begin_left(), 1);
+  EXPECT_EQ(*b.lower_bound_left(4), 5);
+  EXPECT_EQ(*b.upper_bound_right(-7), -5);
+  EXPECT_EQ(*--it, 3);
+  EXPECT_EQ(*++it, 5);
+  EXPECT_EQ(*++it, 7);
+
+  std::vector<int> lefts;
+  for (auto i = b.begin_left(); i != b.end_left(); ++i) {
+    lefts.push_back(*i);
+  }
+  EXPECT_EQ(lefts, std::vector<int>({1, 2, 3, 5, 7, 8, 9}));
+
+  // ключи удаленных пар можно вставлять снова
+  EXPECT_NE(b.insert(4, -6), b.end_left());
+  EXPECT_EQ(b.dead_count(), 1);
+
+  b.compact();
+  EXPECT_EQ(b.dead_count(), 0);
+  EXPECT_EQ(b.size(), 8);
+  EXPECT_EQ(*it, 7);
+  EXPECT_EQ(*it.flip(), -7);
+  EXPECT_EQ(b.at_right(-6), 4);
+}
+
+TEST(bimap, lazy_erase_auto_compact) {
+  lazy_bimap<int, int> b;
+  b.set_lazy_erase(0.5);
+  for (int i = 0; i < 10; i++) {
+    b.insert(i, i);
+  }
+  for (int i = 0; i < 5; i++) {
+    b.erase_left(i);
+  }
+  EXPECT_EQ(b.dead_count(), 5);
+  b.erase_left(5);
+  EXPECT_EQ(b.dead_count(), 0);
+  EXPECT_EQ(b.size(), 4);
+  EXPECT_EQ(*b.begin_right(), 6);
+}
+
+TEST(bimap_randomized, lazy_erase_compare_to_two_maps) {
+  std::mt19937 e(seed);
+  lazy_bimap<address_checking_object, int> b;
+  b.set_lazy_erase(0.3);
+  std::map<int, int> left_view, right_view;
+  for (size_t i = 0; i < 20000; i++) {
+    int l = static_cast<int>(e() % 500), r = static_cast<int>(e() % 500);
+    if (e() % 2) {
+      bool inserted = b.insert(l, r) != b.end_left();
+      bool expected = !left_view.contains(l) && !right_view.contains(r);
+      EXPECT_EQ(inserted, expected);
+      if (expected) {
+        left_view[l] = r;
+        right_view[r] = l;
+      }
+    } else if (b.erase_left(l)) {
+      right_view.erase(left_view[l]);
+      left_view.erase(l);
+    }
+    if (i % 500 == 0) {
+      EXPECT_EQ(b.size(), left_view.size());
+      auto it = b.begin_left();
+      for (auto [k, v] : left_view) {
+        EXPECT_EQ(static_cast<int>(*it), k);
+        EXPECT_EQ(*it.flip(), v);
+        ++it;
+      }
+      EXPECT_EQ(it, b.end_left());
+    }
+  }
+  b.erase_left(b.begin_left(), b.end_left());
+  EXPECT_TRUE(b.empty());
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "nodes.h"
+#include <vector>
 
 template <typename Left, typename Right, typename Tag, typename Comp>
 struct tree : private Comp {
@@ -23,6 +24,20 @@ struct tree : private Comp {
     root->update_children_links();
   }
 
+  // Добавляет узлы, которых еще нет в дереве, nodes должны быть отсортированы
+  // по ключу и не содержать равных. Из nodes за линию строится декартово
+  // дерево, которое затем объединяется с текущим через split.
+  void insert_sorted(std::vector<node_t*> const& nodes) {
+    root->left = unite(root->left, build(nodes));
+    root->update_children_links();
+  }
+
+  // Пересобирает дерево из узлов, отсортированных по ключу, за линию
+  void rebuild(std::vector<node_t*> const& nodes) {
+    root->left = build(nodes);
+    root->update_children_links();
+  }
+
   void erase(node_t* n) {
     if (n->parent->left == n) {
       n->parent->left = merge(n->left, n->right);
@@ -63,6 +78,10 @@ struct tree : private Comp {
     }
   }
 
+  bool less(T const& lhs, T const& rhs) const {
+    return comp(lhs, rhs);
+  }
+
   // проверка на равенство через comp
   bool equal(T const& lhs, T const& rhs) const {
     return !comp(lhs, rhs) && or_equal_comp(lhs, rhs);
@@ -138,6 +157,49 @@ private:
     }
   }
 
+  // Декартово дерево по отсортированным узлам: поднимаемся от последнего
+  // добавленного узла по правой ветке, пока приоритет меньше нового
+  node_t* build(std::vector<node_t*> const& nodes) {
+    node_t* top = nullptr;
+    node_t* last = nullptr;
+    for (node_t* n : nodes) {
+      node_t* cur = last;
+      node_t* child = nullptr;
+      while (cur && get_priority(cur) < get_priority(n)) {
+        child = cur;
+        cur = cur->parent;
+      }
+      n->left = child;
+      n->right = nullptr;
+      n->update_children_links();
+      n->parent = cur;
+      if (cur) {
+        cur->right = n;
+      } else {
+        top = n;
+      }
+      last = n;
+    }
+    return top;
+  }
+
+  // Объединение деревьев без общих ключей
+  node_t* unite(node_t* a, node_t* b) {
+    if (!a)
+      return b;
+    if (!b)
+      return a;
+
+    if (get_priority(a) < get_priority(b)) {
+      std::swap(a, b);
+    }
+    auto tmp = split<false>(b, get_value(a));
+    a->left = unite(a->left, tmp.first);
+    a->right = unite(a->right, tmp.second);
+    a->update_children_links();
+    return a;
+  }
+
   template <bool OrEqualComp>
   node_t* bound(node_t* n, T const& val) const {
     if (!n) {
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "epoch.h"
+#include "function.h"
+
+#include <atomic>
+#include <utility>
+
+// Вызываемый объект, который можно заменить на лету, пока другие потоки его
+// вызывают. Каждый store публикует новый неизменяемый function через
+// атомарный указатель, старый удаляется через epoch::retire, когда его
+// перестанут вызывать. Вызов: вход в epoch::guard (запись в ячейку своего
+// потока), загрузка указателя и вызов -- без циклов и RMW на общих данных.
+template <typename F>
+struct atomic_function;
+
+template <typename R, typename... Args>
+struct atomic_function<R(Args...)> {
+  using function_t = function<R(Args...)>;
+
+  atomic_function() = default;
+
+  explicit atomic_function(function_t f) : current(make(std::move(f))) {}
+
+  atomic_function(atomic_function const&) = delete;
+  atomic_function& operator=(atomic_function const&) = delete;
+
+  // Вызовы к этому моменту должны завершиться
+  ~atomic_function() {
+    delete current.load(std::memory_order_relaxed);
+  }
+
+  // Пустой f -- вызовы будут бросать bad_function_call
+  void store(function_t f) {
+    function_t* old = current.exchange(make(std::move(f)));
+    if (old) {
+      epoch::retire(old);
+    }
+  }
+
+  function_t load() const {
+    epoch::guard guard;
+    function_t const* f = current.load();
+    return f ? *f : function_t();
+  }
+
+  R operator()(Args... args) const {
+    epoch::guard guard;
+    function_t const* f = current.load();
+    if (!f) {
+      throw bad_function_call{};
+    }
+    return (*f)(std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const {
+    epoch::guard guard;
+    return current.load() != nullptr;
+  }
+
+private:
+  static function_t* make(function_t f) {
+    return f ? new function_t(std::move(f)) : nullptr;
+  }
+
+  std::atomic<function_t*> current{nullptr};
+};
@@ -0,0 +1,378 @@
+#include "function.h"
+#include "function_vector.h"
+#include "mpsc_queue.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <random>
+#include <vector>
+
+// Счетчик аллокаций через замену глобального operator new
+namespace {
+std::size_t allocations = 0;
+} // namespace
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+template <typename T>
+void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <std::size_t Bytes>
+struct capture {
+  std::array<char, Bytes> payload{};
+
+  int operator()(int x) const {
+    return x + payload[Bytes / 2];
+  }
+};
+
+template <>
+struct capture<0> {
+  int operator()(int x) const {
+    return x + 1;
+  }
+};
+
+constexpr std::size_t iterations = 1'000'000;
+
+struct result {
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+// ops -- сколько операций делает одна итерация body
+template <typename Body>
+result measure(Body&& body, std::size_t ops = 1) {
+  std::size_t allocs_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    body(i);
+  }
+  auto finish = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double, std::nano>(finish - start).count() /
+              (iterations * ops),
+          static_cast<double>(allocations - allocs_before) /
+              (iterations * ops)};
+}
+
+template <typename F, std::size_t Bytes>
+void run(char const* name) {
+  result ctor = measure([](std::size_t) {
+    F f = capture<Bytes>();
+    do_not_optimize(f);
+  });
+
+  F f = capture<Bytes>();
+  int acc = 0;
+  result invoke = measure([&](std::size_t i) {
+    acc += f(static_cast<int>(i));
+    do_not_optimize(acc);
+  });
+
+  std::printf("%-20s %5zu %14.2f %12.2f %14.2f\n", name, Bytes, ctor.ns_per_op,
+              ctor.allocs_per_op, invoke.ns_per_op);
+}
+
+// Много разных типов -- много описателей, вызовы идут вразнобой, так что
+// строки описателей часто не в кэше
+template <std::size_t Id>
+struct distinct {
+  int operator()(int x) const {
+    return x * static_cast<int>(Id + 1);
+  }
+};
+
+constexpr std::size_t dispatch_types = 256;
+constexpr std::size_t dispatch_size = 1 << 16;
+
+template <typename F, std::size_t... Ids>
+std::vector<F> make_dispatch(std::index_sequence<Ids...>) {
+  std::vector<F> kinds = {F(distinct<Ids>())...};
+  std::vector<F> res;
+  std::mt19937 e(1);
+  for (std::size_t i = 0; i < dispatch_size; i++) {
+    res.push_back(kinds[e() % kinds.size()]);
+  }
+  return res;
+}
+
+template <typename F>
+void run_dispatch(char const* name) {
+  auto funcs = make_dispatch<F>(std::make_index_sequence<dispatch_types>());
+  // вытесняем описатели из кэша между проходами
+  std::vector<char> trash(8 << 20);
+  int acc = 0;
+  double total = 0;
+  constexpr std::size_t rounds = 20;
+  for (std::size_t r = 0; r < rounds; r++) {
+    for (std::size_t i = 0; i < trash.size(); i += 64) {
+      trash[i]++;
+    }
+    do_not_optimize(trash.data());
+    auto start = std::chrono::steady_clock::now();
+    for (auto const& f : funcs) {
+      acc += f(1);
+    }
+    auto finish = std::chrono::steady_clock::now();
+    total += std::chrono::duration<double, std::nano>(finish - start).count();
+  }
+  do_not_optimize(acc);
+  std::printf("%-28s %10.2f\n", name, total / (rounds * funcs.size()));
+}
+
+// Виды вызываемых объектов для сравнения с std::function
+int plain_function(int x) {
+  return x + 1;
+}
+
+template <std::size_t Bytes>
+auto make_lambda() {
+  if constexpr (Bytes == 0) {
+    return [](int x) { return x + 1; };
+  } else {
+    return [payload = std::array<char, Bytes>{}](int x) {
+      return x + payload[Bytes / 2];
+    };
+  }
+}
+
+template <std::size_t Bytes>
+struct holder {
+  int call(int x) const {
+    return x + data.payload[Bytes / 2];
+  }
+
+  capture<Bytes> data;
+};
+
+template <>
+struct holder<0> {
+  int call(int x) const {
+    return x + 1;
+  }
+};
+
+template <std::size_t Bytes>
+auto make_binder() {
+  return std::bind_front(&holder<Bytes>::call, holder<Bytes>());
+}
+
+// Перемещение может бросать -- такой объект нельзя хранить в буфере
+template <std::size_t Bytes>
+struct throwing_move : capture<Bytes> {
+  throwing_move() = default;
+  throwing_move(throwing_move const&) = default;
+
+  throwing_move(throwing_move&& other) noexcept(false)
+      : capture<Bytes>(other) {}
+};
+
+template <typename F, typename C>
+void compare(char const* kind, std::size_t bytes, char const* name,
+             C const& callable) {
+  result ctor = measure([&](std::size_t) {
+    F f = callable;
+    do_not_optimize(f);
+  });
+
+  F f = callable;
+  result copy = measure([&](std::size_t) {
+    F g = f;
+    do_not_optimize(g);
+  });
+
+  // два перемещения за итерацию, чтобы f остался непустым
+  result move = measure(
+      [&](std::size_t) {
+        F g = std::move(f);
+        do_not_optimize(g);
+        f = std::move(g);
+      },
+      2);
+
+  F other = callable;
+  result swap = measure([&](std::size_t) {
+    f.swap(other);
+    do_not_optimize(f);
+  });
+
+  int acc = 0;
+  result invoke = measure([&](std::size_t i) {
+    acc += f(static_cast<int>(i));
+    do_not_optimize(acc);
+  });
+
+  std::printf("%-14s %5zu %-14s %8.2f %6.2f %8.2f %6.2f %8.2f %6.2f %8.2f "
+              "%8.2f\n",
+              kind, bytes, name, ctor.ns_per_op, ctor.allocs_per_op,
+              copy.ns_per_op, copy.allocs_per_op, move.ns_per_op,
+              move.allocs_per_op, swap.ns_per_op, invoke.ns_per_op);
+}
+
+template <typename C>
+void compare_both(char const* kind, std::size_t bytes, C const& callable) {
+  compare<function<int(int)>>(kind, bytes, "function", callable);
+  compare<std::function<int(int)>>(kind, bytes, "std::function", callable);
+}
+
+template <std::size_t Bytes>
+void compare_all() {
+  compare_both("lambda", Bytes, make_lambda<Bytes>());
+  compare_both("binder", Bytes, make_binder<Bytes>());
+  compare_both("throwing move", Bytes, throwing_move<Bytes>());
+}
+
+// Тот же набор разнотипных объектов: vector<function> против function_vector
+template <std::size_t Id>
+struct accumulate {
+  void operator()(int& acc) const {
+    acc = acc * 3 + static_cast<int>(Id);
+  }
+};
+
+constexpr std::size_t batch_types = 16;
+
+template <std::size_t... Ids>
+void run_batch(std::index_sequence<Ids...>) {
+  using adder = void (*)(std::vector<function<void(int&)>>&,
+                         function_vector<void(int&)>&);
+  adder adders[] = {[](std::vector<function<void(int&)>>& funcs,
+                       function_vector<void(int&)>& packed) {
+    funcs.push_back(accumulate<Ids>());
+    packed.append(accumulate<Ids>());
+  }...};
+  std::vector<function<void(int&)>> funcs;
+  function_vector<void(int&)> packed;
+  std::mt19937 e(1);
+  for (std::size_t i = 0; i < dispatch_size; i++) {
+    adders[e() % batch_types](funcs, packed);
+  }
+
+  constexpr std::size_t rounds = 100;
+  int acc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t r = 0; r < rounds; r++) {
+    for (auto const& f : funcs) {
+      f(acc);
+    }
+  }
+  auto middle = std::chrono::steady_clock::now();
+  for (std::size_t r = 0; r < rounds; r++) {
+    packed.invoke_all(acc);
+  }
+  auto finish = std::chrono::steady_clock::now();
+  do_not_optimize(acc);
+  auto per_call = [](auto d) {
+    return std::chrono::duration<double, std::nano>(d).count() /
+           (rounds * dispatch_size);
+  };
+  std::printf("%-28s %10.2f\n", "vector<function>", per_call(middle - start));
+  std::printf("%-28s %10.2f\n", "function_vector", per_call(finish - middle));
+}
+
+// Постановка и выполнение задачи с захватом Bytes байт: mpsc_queue против
+// мьютекса с deque<std::function>
+template <std::size_t Bytes>
+void run_queue() {
+  constexpr std::size_t batch = 64;
+  int acc = 0;
+
+  mpsc_queue<> q(batch);
+  result ring = measure(
+      [&](std::size_t) {
+        for (std::size_t i = 0; i < batch; i++) {
+          q.push([c = capture<Bytes>(), &acc] { acc = c(acc); });
+        }
+        q.drain();
+      },
+      batch);
+
+  std::mutex m;
+  std::deque<std::function<void()>> d;
+  result locked = measure(
+      [&](std::size_t) {
+        for (std::size_t i = 0; i < batch; i++) {
+          std::lock_guard lock(m);
+          d.emplace_back([c = capture<Bytes>(), &acc] { acc = c(acc); });
+        }
+        std::lock_guard lock(m);
+        while (!d.empty()) {
+          d.front()();
+          d.pop_front();
+        }
+      },
+      batch);
+  do_not_optimize(acc);
+
+  std::printf("%-28s %5zu %10.2f %10.2f\n", "mpsc_queue", Bytes,
+              ring.ns_per_op, ring.allocs_per_op);
+  std::printf("%-28s %5zu %10.2f %10.2f\n", "mutex + deque<std::function>",
+              Bytes, locked.ns_per_op, locked.allocs_per_op);
+}
+
+template <std::size_t Bytes>
+void run_all() {
+  run<function<int(int)>, Bytes>("function");
+  run<function_sbo<int(int), 16>, Bytes>("function_sbo<16>");
+  run<function_sbo<int(int), 32>, Bytes>("function_sbo<32>");
+  run<function_sbo<int(int), 64>, Bytes>("function_sbo<64>");
+}
+} // namespace
+
+int main() {
+  std::printf("%-14s %5s %-14s %8s %6s %8s %6s %8s %6s %8s %8s\n", "callable",
+              "bytes", "wrapper", "ctor ns", "allocs", "copy ns", "allocs",
+              "move ns", "allocs", "swap ns", "call ns");
+  compare_both("fn pointer", sizeof(&plain_function), &plain_function);
+  compare_all<0>();
+  compare_all<8>();
+  compare_all<16>();
+  compare_all<32>();
+  compare_all<64>();
+  compare_all<128>();
+
+  std::printf("\n%-20s %5s %14s %12s %14s\n", "wrapper", "bytes",
+              "ctor+dtor ns", "allocs/op", "invoke ns");
+  run_all<0>();
+  run_all<8>();
+  run_all<16>();
+  run_all<32>();
+  run_all<64>();
+  run_all<128>();
+
+  std::printf("\n%-28s %10s\n", "dispatch, cold descriptors", "invoke ns");
+  run_dispatch<function<int(int)>>("function");
+  run_dispatch<function_sbo<int(int), 8, 8, true>>("function (inline invoke)");
+
+  std::printf("\n%-28s %10s\n", "batch, 16 types", "invoke ns");
+  run_batch(std::make_index_sequence<batch_types>());
+
+  std::printf("\n%-28s %5s %10s %10s\n", "queue, push + drain", "bytes",
+              "ns/task", "allocs");
+  run_queue<0>();
+  run_queue<16>();
+  run_queue<32>();
+}
@@ -0,0 +1,150 @@
+#include "epoch.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+// Ячейка потока: 0 -- вне guard, иначе эпоха, объявленная при входе.
+// Ячейки не удаляются, завершившийся поток отдает свою следующему
+struct record {
+  std::atomic<std::uint64_t> announced{0};
+  std::atomic<bool> used{true};
+  record* next = nullptr;
+};
+
+struct retired {
+  void* ptr;
+  void (*deleter)(void*);
+  std::uint64_t epoch;
+};
+
+// эпохи начинаются с 1, 0 в ячейке -- поток вне guard
+std::atomic<std::uint64_t> global_epoch{1};
+std::atomic<record*> records{nullptr};
+
+void destroy(std::vector<retired> const& items) {
+  for (auto const& r : items) {
+    r.deleter(r.ptr);
+  }
+}
+
+// При завершении программы читателей уже нет, удаляем оставшееся
+struct retired_storage : std::vector<retired> {
+  ~retired_storage() {
+    destroy(*this);
+  }
+};
+
+std::mutex retired_mutex;
+retired_storage retired_list;
+
+record* acquire_record() {
+  for (record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+    bool expected = false;
+    if (!r->used.load(std::memory_order_relaxed) &&
+        r->used.compare_exchange_strong(expected, true)) {
+      return r;
+    }
+  }
+  auto* r = new record();
+  r->next = records.load(std::memory_order_relaxed);
+  while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+  }
+  return r;
+}
+
+struct thread_state {
+  thread_state() : rec(acquire_record()) {}
+
+  ~thread_state() {
+    rec->announced.store(0, std::memory_order_release);
+    rec->used.store(false, std::memory_order_release);
+  }
+
+  record* rec;
+  std::size_t depth = 0;
+};
+
+thread_state& local() {
+  thread_local thread_state state;
+  return state;
+}
+
+// Продвигает эпоху, если все читатели внутри guard видели текущую
+bool try_advance() {
+  std::uint64_t e = global_epoch.load();
+  for (record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+    std::uint64_t a = r->announced.load();
+    if (a != 0 && a != e) {
+      return false;
+    }
+  }
+  // неудача CAS значит, что эпоху уже продвинули
+  global_epoch.compare_exchange_strong(e, e + 1);
+  return true;
+}
+
+// Под retired_mutex. Возвращает объекты, которые уже можно удалить
+std::vector<retired> collect() {
+  std::uint64_t e = global_epoch.load();
+  std::vector<retired> res;
+  std::erase_if(retired_list, [&](retired const& r) {
+    if (r.epoch + 2 <= e) {
+      res.push_back(r);
+      return true;
+    }
+    return false;
+  });
+  return res;
+}
+} // namespace
+
+epoch::guard::guard() noexcept {
+  thread_state& s = local();
+  if (s.depth++ == 0) {
+    // seq_cst: объявление видно писателю раньше, чем мы прочитаем указатель
+    s.rec->announced.store(global_epoch.load(std::memory_order_relaxed));
+  }
+}
+
+epoch::guard::~guard() {
+  thread_state& s = local();
+  if (--s.depth == 0) {
+    s.rec->announced.store(0, std::memory_order_release);
+  }
+}
+
+void epoch::retire(void* ptr, void (*deleter)(void*)) {
+  std::vector<retired> ready;
+  {
+    std::lock_guard lock(retired_mutex);
+    retired_list.push_back({ptr, deleter, global_epoch.load()});
+    try_advance();
+    ready = collect();
+  }
+  destroy(ready);
+}
+
+void epoch::synchronize() {
+  std::uint64_t target = global_epoch.load() + 2;
+  while (global_epoch.load() < target) {
+    if (!try_advance()) {
+      std::this_thread::yield();
+    }
+  }
+  std::vector<retired> ready;
+  {
+    std::lock_guard lock(retired_mutex);
+    ready = collect();
+  }
+  destroy(ready);
+}
+
+std::size_t epoch::pending() {
+  std::lock_guard lock(retired_mutex);
+  return retired_list.size();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+// Отложенное освобождение по эпохам (EBR) для структур, которые читают без
+// блокировок. Читатель на время доступа держит epoch::guard: вход -- одна
+// запись в собственную ячейку потока, без RMW на общих данных и без циклов.
+// Писатель снимает объект из общего доступа и отдает его в retire, объект
+// удаляется, когда глобальная эпоха продвинется на два шага: к этому моменту
+// все читатели, которые могли его видеть, вышли.
+namespace epoch {
+// Вложенные guard одного потока допустимы
+struct guard {
+  guard() noexcept;
+  ~guard();
+
+  guard(guard const&) = delete;
+  guard& operator=(guard const&) = delete;
+};
+
+// Объект уже недоступен новым читателям. deleter будет вызван из какого-то
+// последующего retire или synchronize
+void retire(void* ptr, void (*deleter)(void*));
+
+template <typename T>
+void retire(T* ptr) {
+  retire(static_cast<void*>(ptr), [](void* p) { delete static_cast<T*>(p); });
+}
+
+// Дожидается выхода текущих читателей и удаляет все отданные в retire
+// объекты. Нельзя вызывать, держа guard
+void synchronize();
+
+// Число объектов, ожидающих удаления
+std::size_t pending();
+} // namespace epoch
@@ -1,6 +1,13 @@
 #pragma once
 
+#include "profiling_scope.h"
+
+#include <atomic>
 #include <exception>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 struct bad_function_call : std::exception {
   char const* what() const noexcept override {
@@ -8,180 +15,611 @@ struct bad_function_call : std::exception {
   }
 };
 
+struct bad_function_conversion : std::exception {
+  char const* what() const noexcept override {
+    return "bad function conversion";
+  }
+};
+
 namespace details {
-using storage_t = std::aligned_storage_t<sizeof(void*), alignof(void*)>;
+template <std::size_t Size, std::size_t Align>
+using buffer_t = std::aligned_storage_t<Size, Align>;
 
-template <typename T>
-constexpr inline bool fits_small =
-    sizeof(T) < sizeof(storage_t) && std::is_nothrow_move_constructible_v<T> &&
-    alignof(storage_t) % alignof(T) == 0 &&
-    std::is_nothrow_move_assignable_v<T>;
+using storage_t = buffer_t<sizeof(void*), alignof(void*)>;
 
-template <typename T>
-static T* get_func(storage_t* s) {
+// Объект в буфере только создается перемещением и уничтожается, поэтому
+// присваивание не требуется (у лямбд с захватом его нет)
+template <typename T, typename Storage = storage_t>
+constexpr inline bool fits_small = sizeof(T) <= sizeof(Storage) &&
+                                   std::is_nothrow_move_constructible_v<T> &&
+                                   alignof(Storage) % alignof(T) == 0;
+
+template <typename T, typename Storage>
+static T* get_func(Storage* s) {
   return reinterpret_cast<T*>(s);
 }
 
-template <typename T>
-static T const* get_func(storage_t const* s) {
+template <typename T, typename Storage>
+static T const* get_func(Storage const* s) {
   return reinterpret_cast<T const*>(s);
 }
 
-template <typename T>
-static T* get_func_from_ptr(storage_t* s) {
+template <typename T, typename Storage>
+static T* get_func_from_ptr(Storage* s) {
   return *get_func<T*>(s);
 }
 
-template <typename T>
-static T const* get_func_from_ptr(storage_t const* s) {
+template <typename T, typename Storage>
+static T const* get_func_from_ptr(Storage const* s) {
   return *get_func<T const*>(s);
 }
+
+// Адрес id отличает T от других типов. Адреса функций описателя для этого не
+// подходят: компоновщик может склеить одинаковые функции разных типов (ICF)
+template <typename T>
+struct type_tag {
+  inline static char id;
+};
+
+// Тривиальные объекты копируются вместе со всем буфером, поэтому байты за
+// маленьким объектом инициализируются
+template <typename T, typename Storage>
+void construct_small(Storage& s, T&& val) {
+  using U = std::remove_cvref_t<T>;
+  if constexpr (std::is_trivially_copyable_v<U> &&
+                sizeof(U) < sizeof(Storage)) {
+    s = Storage{};
+  }
+  new (&s) U(std::forward<T>(val));
+}
+
+// Объект в блоке, на который указывает буфер. Объект, созданный через new,
+// сам себе блок
+template <typename T, typename Block>
+T* object_of(Block* b) noexcept {
+  if constexpr (std::is_same_v<T, Block>) {
+    return b;
+  } else {
+    return &b->obj;
+  }
+}
+
+// Большой объект, размещенный пользовательским аллокатором, вместе с
+// аллокатором в одном блоке. В буфере лежит указатель на блок: от T* к блоку
+// перейти нельзя, если блок не standard-layout (а у лямбд это не так)
+template <typename T, typename Alloc>
+struct allocated {
+  using block_alloc = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<allocated>;
+  using traits = std::allocator_traits<block_alloc>;
+
+  template <typename... A>
+  allocated(Alloc const& a, A&&... args)
+      : obj(std::forward<A>(args)...), alloc(a) {}
+
+  template <typename... A>
+  static allocated* create(Alloc const& alloc, A&&... args) {
+    block_alloc a(alloc);
+    allocated* b = traits::allocate(a, 1);
+    try {
+      new (b) allocated(alloc, std::forward<A>(args)...);
+    } catch (...) {
+      traits::deallocate(a, b, 1);
+      throw;
+    }
+    return b;
+  }
+
+  static allocated* copy(allocated const* b) {
+    return create(b->alloc, b->obj);
+  }
+
+  static void destroy(allocated* b) noexcept {
+    if (b) {
+      block_alloc a(b->alloc);
+      b->~allocated();
+      traits::deallocate(a, b, 1);
+    }
+  }
+
+  T obj;
+  [[no_unique_address]] Alloc alloc;
+};
+
+// Большой объект в блоке со счетчиком ссылок: копирование function только
+// увеличивает счетчик, объект копируется при изменяющем доступе через
+// target<T>(). Как и в allocated, в буфере лежит указатель на блок.
+template <typename T>
+struct shared {
+  template <typename... A>
+  explicit shared(A&&... args) : obj(std::forward<A>(args)...) {}
+
+  static shared* acquire(shared const* b) noexcept {
+    b->refs.fetch_add(1, std::memory_order_relaxed);
+    return const_cast<shared*>(b);
+  }
+
+  static void release(shared* b) noexcept {
+    if (b && b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete b;
+    }
+  }
+
+  // Возвращает блок, которым владеет только вызывающий
+  static shared* unshare(shared* b) {
+    if (b->refs.load(std::memory_order_acquire) == 1) {
+      return b;
+    }
+    shared* res = new shared(b->obj);
+    release(b);
+    return res;
+  }
+
+  T obj;
+  mutable std::atomic<std::size_t> refs{1};
+};
 } // namespace details
 
+// Тег конструктора function: большой объект хранится в разделяемом блоке
+// (см. details::shared)
+struct shared_storage_t {
+  explicit shared_storage_t() = default;
+};
+
+inline constexpr shared_storage_t shared_storage{};
+
+// Тег конструктора unique_function: описатель хранимого объекта содержит
+// копирование, и unique_function можно преобразовать в function
+struct copyable_storage_t {
+  explicit copyable_storage_t() = default;
+};
+
+inline constexpr copyable_storage_t copyable_storage{};
+
 namespace descriptor {
-template <typename R, typename... Args>
-struct type_descriptor {
-  void (*copy)(details::storage_t const& src, details::storage_t& dst);
-  void (*move)(details::storage_t& src, details::storage_t& dst);
-  void (*destroy)(details::storage_t& src);
-  R (*invoke)(details::storage_t const& src, Args... args);
-
-  template <typename T>
-  static type_descriptor<R, Args...> const* get_descriptor() noexcept {
-    if constexpr (details::fits_small<T>) {
-      constexpr static type_descriptor<R, Args...> result = {
-          [](details::storage_t const& src, details::storage_t& dst) {
-            // copy
-            new (&dst) T(*details::get_func<T>(&src));
-          },
-          [](details::storage_t& src, details::storage_t& dst) {
-            // move
-            new (&dst) T(std::move(*details::get_func<T>(&src)));
-          },
-          [](details::storage_t& src) {
-            // destroy
-            details::get_func<T>(&src)->~T();
-          },
-          [](details::storage_t const& src, Args... args) -> R {
-            // invoke
-            return (*details::get_func<T>(&src))(std::forward<Args>(args)...);
-          }};
-      return &result;
+template <typename Storage, typename R, typename... Args>
+struct type_descriptor;
+
+// Операции, нужные и function, и unique_function
+template <typename Storage, typename R, typename... Args>
+struct move_descriptor {
+  void (*move)(Storage& src, Storage& dst);
+  void (*destroy)(Storage& src);
+  R (*invoke)(Storage const& src, Args... args);
+  // описатель на самом деле type_descriptor
+  bool copyable;
+  // объект лежит в буфере и тривиально копируется и уничтожается:
+  // копирование и перемещение -- memcpy буфера, уничтожать не нужно
+  bool trivial;
+  // &details::type_tag<T>::id, у пустого -- nullptr
+  void const* type;
+  // хранимый объект, для target()
+  void* (*object)(Storage const& src);
+
+  // Операция копирования не инстанцируется: у T она может быть объявлена,
+  // но не компилироваться (лямбда, захватившая vector<unique_ptr>)
+  template <typename T>
+  static move_descriptor const* get_descriptor() noexcept {
+    constexpr static move_descriptor result = make<T>();
+    return &result;
+  }
+
+  // Большой T, размещенный через Alloc (см. details::allocated)
+  template <typename T, typename Alloc>
+  static move_descriptor const* get_allocated_descriptor() noexcept {
+    constexpr static move_descriptor result = make_allocated<T, Alloc>();
+    return &result;
+  }
+
+  template <typename T, typename Alloc>
+  static constexpr move_descriptor make_allocated() noexcept {
+    using block = details::allocated<T, Alloc>;
+    return make_boxed<T, block>([](Storage& src) {
+      // destroy
+      block::destroy(details::get_func_from_ptr<block>(&src));
+    });
+  }
+
+  // Большой T в блоке Block, в буфере -- Block*
+  template <typename T, typename Block>
+  static constexpr move_descriptor
+  make_boxed(void (*destroy)(Storage& src)) noexcept {
+    return {[](Storage& src, Storage& dst) {
+              // move
+              new (&dst) Block*(details::get_func_from_ptr<Block>(&src));
+              reinterpret_cast<Block*&>(src) = nullptr;
+            },
+            destroy,
+            [](Storage const& src, Args... args) -> R {
+              // invoke
+              [[maybe_unused]] profiling::scope<T> scope;
+              return (*details::object_of<T const>(
+                  details::get_func_from_ptr<Block>(&src)))(
+                  std::forward<Args>(args)...);
+            },
+            false,
+            false,
+            &details::type_tag<T>::id,
+            [](Storage const& src) -> void* {
+              return details::object_of<T>(
+                  const_cast<Block*>(details::get_func_from_ptr<Block>(&src)));
+            }};
+  }
+
+  template <typename T>
+  static constexpr bool is_trivial = details::fits_small<T, Storage> &&
+                                     std::is_trivially_copyable_v<T> &&
+                                     std::is_trivially_destructible_v<T>;
+
+  template <typename T>
+  static constexpr move_descriptor make() noexcept {
+    if constexpr (details::fits_small<T, Storage>) {
+      return {[](Storage& src, Storage& dst) {
+                // move
+                new (&dst) T(std::move(*details::get_func<T>(&src)));
+              },
+              [](Storage& src) {
+                // destroy
+                details::get_func<T>(&src)->~T();
+              },
+              [](Storage const& src, Args... args) -> R {
+                // invoke
+                [[maybe_unused]] profiling::scope<T> scope;
+                return (*details::get_func<T>(&src))(
+                    std::forward<Args>(args)...);
+              },
+              false,
+              is_trivial<T>,
+              &details::type_tag<T>::id,
+              [](Storage const& src) -> void* {
+                return const_cast<T*>(details::get_func<T>(&src));
+              }};
     } else {
-      constexpr static type_descriptor<R, Args...> result = {
-          [](details::storage_t const& src, details::storage_t& dst) {
-            // copy
-            auto ptr = new T(*details::get_func_from_ptr<T>(&src));
-            new (&dst) T*(ptr);
-          },
-          [](details::storage_t& src, details::storage_t& dst) {
-            // move
-            new (&dst) T*(details::get_func_from_ptr<T>(&src));
-            reinterpret_cast<T*&>(src) = nullptr;
-          },
-          [](details::storage_t& src) {
-            // destroy
-            delete details::get_func_from_ptr<T>(&src);
-          },
-          [](details::storage_t const& src, Args... args) -> R {
-            // invoke
-            return (*details::get_func_from_ptr<T>(&src))(
-                std::forward<Args>(args)...);
-          }};
-      return &result;
-    }
-  }
-
-  static type_descriptor<R, Args...> const* get_empty_descriptor() noexcept {
-    constexpr static type_descriptor<R, Args...> result = {
-        [](details::storage_t const& src, details::storage_t& dst) {
+      return make_boxed<T, T>([](Storage& src) {
+        // destroy
+        delete details::get_func_from_ptr<T>(&src);
+      });
+    }
+  }
+};
+
+template <typename Storage, typename R, typename... Args>
+struct type_descriptor : move_descriptor<Storage, R, Args...> {
+  using base = move_descriptor<Storage, R, Args...>;
+
+  void (*copy)(Storage const& src, Storage& dst);
+
+  static constexpr type_descriptor
+  with_copy(base ops, void (*copy)(Storage const&, Storage&)) noexcept {
+    ops.copyable = true;
+    return {ops, copy};
+  }
+
+  template <typename T>
+  static type_descriptor const* get_descriptor() noexcept {
+    constexpr static type_descriptor result = make_copyable<T>();
+    return &result;
+  }
+
+  template <typename T>
+  static constexpr type_descriptor make_copyable() noexcept {
+    if constexpr (details::fits_small<T, Storage>) {
+      return with_copy(base::template make<T>(),
+                       [](Storage const& src, Storage& dst) {
+                         // copy
+                         new (&dst) T(*details::get_func<T>(&src));
+                       });
+    } else {
+      return with_copy(base::template make<T>(),
+                       [](Storage const& src, Storage& dst) {
+                         // copy
+                         auto ptr = new T(*details::get_func_from_ptr<T>(&src));
+                         new (&dst) T*(ptr);
+                       });
+    }
+  }
+
+  template <typename T, typename Alloc>
+  static type_descriptor const* get_allocated_descriptor() noexcept {
+    constexpr static type_descriptor result =
+        with_copy(base::template make_allocated<T, Alloc>(),
+                  [](Storage const& src, Storage& dst) {
+                    // copy
+                    using block = details::allocated<T, Alloc>;
+                    new (&dst) block*(
+                        block::copy(details::get_func_from_ptr<block>(&src)));
+                  });
+    return &result;
+  }
+
+  template <typename T>
+  static type_descriptor const* get_shared_descriptor() noexcept {
+    using block = details::shared<T>;
+    constexpr static type_descriptor result =
+        with_copy(base::template make_boxed<T, block>([](Storage& src) {
+                    // destroy
+                    block::release(details::get_func_from_ptr<block>(&src));
+                  }),
+                  [](Storage const& src, Storage& dst) {
+                    // copy
+                    new (&dst) block*(block::acquire(
+                        details::get_func_from_ptr<block>(&src)));
+                  });
+    return &result;
+  }
+
+  static type_descriptor const* get_empty_descriptor() noexcept {
+    constexpr static type_descriptor result = make_empty();
+    return &result;
+  }
+
+  static constexpr type_descriptor make_empty() noexcept {
+    return {
+        {[](Storage& src, Storage& dst) {
+           // move
+           dst = src;
+         },
+         [](Storage&) {
+           // destroy
+         },
+         [](Storage const&, Args...) -> R {
+           // invoke
+           throw bad_function_call{};
+         },
+         true,
+         true,
+         nullptr,
+         [](Storage const&) -> void* {
+           return nullptr;
+         }},
+        [](Storage const& src, Storage& dst) {
           // copy
           dst = src;
-        },
-        [](details::storage_t& src, details::storage_t& dst) {
-          // move
-          dst = src;
-        },
-        [](details::storage_t&) {
-          // destroy
-        },
-        [](details::storage_t const&, Args...) -> R {
-          // invoke
-          throw bad_function_call{};
         }};
+  }
+};
+
+// Вызов объекта, хранимого в Storage, с сигнатурой F
+template <typename Storage, typename F>
+struct invoker;
+
+template <typename Storage, typename R, typename... Args>
+struct invoker<Storage, R(Args...)> {
+  using type = R (*)(Storage const& src, Args... args);
+
+  template <typename T>
+  static constexpr bool accepts = std::is_invocable_r_v<R, T const&, Args...>;
+
+  template <typename T>
+  static constexpr type make() noexcept {
+    return [](Storage const& src, Args... args) -> R {
+      // invoke
+      [[maybe_unused]] profiling::scope<T> scope;
+      if constexpr (details::fits_small<T, Storage>) {
+        return (*details::get_func<T>(&src))(std::forward<Args>(args)...);
+      } else {
+        return (*details::get_func_from_ptr<T>(&src))(
+            std::forward<Args>(args)...);
+      }
+    };
+  }
 
+  static constexpr type make_empty() noexcept {
+    return [](Storage const&, Args...) -> R {
+      // invoke
+      throw bad_function_call{};
+    };
+  }
+};
+
+// Описатель function с несколькими сигнатурами: управление объектом -- как
+// у function с первой сигнатурой, плюс по invoke на каждую сигнатуру
+template <typename Storage, typename F, typename... Fs>
+struct multi_descriptor;
+
+template <typename Storage, typename R, typename... Args, typename... Fs>
+struct multi_descriptor<Storage, R(Args...), Fs...>
+    : type_descriptor<Storage, R, Args...> {
+  using base = type_descriptor<Storage, R, Args...>;
+
+  std::tuple<typename invoker<Storage, R(Args...)>::type,
+             typename invoker<Storage, Fs>::type...>
+      invokes;
+
+  template <typename T>
+  static multi_descriptor const* get_descriptor() noexcept {
+    constexpr static multi_descriptor result = {
+        base::template make_copyable<T>(),
+        {invoker<Storage, R(Args...)>::template make<T>(),
+         invoker<Storage, Fs>::template make<T>()...}};
+    return &result;
+  }
+
+  static multi_descriptor const* get_empty_descriptor() noexcept {
+    constexpr static multi_descriptor result = {
+        base::make_empty(),
+        {invoker<Storage, R(Args...)>::make_empty(),
+         invoker<Storage, Fs>::make_empty()...}};
     return &result;
   }
 };
 } // namespace descriptor
 
-template <typename F>
-struct function;
+namespace details {
+struct no_invoke {};
+
+// Copyable = false -- unique_function: хранит и некопируемые объекты,
+// в описателе нет операции копирования.
+// InlineInvoke = true -- указатель на invoke хранится прямо в объекте рядом
+// с буфером, вызов не читает описатель (на слово больше памяти)
+template <typename F, bool Copyable, std::size_t Size, std::size_t Align,
+          bool InlineInvoke>
+struct basic_function;
+
+template <typename R, typename... Args, bool Copyable, std::size_t Size,
+          std::size_t Align, bool InlineInvoke>
+struct basic_function<R(Args...), Copyable, Size, Align, InlineInvoke> {
+private:
+  using storage_t = buffer_t<Size, Align>;
+  using copy_descriptor_t = descriptor::type_descriptor<storage_t, R, Args...>;
+  using descriptor_t =
+      std::conditional_t<Copyable, copy_descriptor_t,
+                         descriptor::move_descriptor<storage_t, R, Args...>>;
+  using invoke_t = R (*)(storage_t const&, Args...);
+
+  static_assert(Size >= sizeof(void*) && Align >= alignof(void*),
+                "buffer must be able to hold a pointer");
 
-template <typename R, typename... Args>
-struct function<R(Args...)> {
-  function() noexcept
-      : desc(descriptor::type_descriptor<R, Args...>::get_empty_descriptor()) {}
+  template <typename F, bool C, std::size_t S, std::size_t A, bool I>
+  friend struct basic_function;
+
+public:
+  // Пустой описатель тривиален, и копия побайтово копирует буфер, поэтому
+  // он инициализируется
+  basic_function() noexcept : storage{} {
+    set_descriptor(copy_descriptor_t::get_empty_descriptor());
+  }
 
-  function(function const& other) : desc(other.desc) {
-    desc->copy(other.storage, this->storage);
+  basic_function(basic_function const& other)
+    requires Copyable
+  {
+    if (other.desc->trivial) {
+      storage = other.storage;
+    } else {
+      other.desc->copy(other.storage, this->storage);
+    }
+    set_descriptor(other.desc);
   }
 
-  function(function&& other) : desc(std::move(other.desc)) {
-    desc->move(other.storage, this->storage);
+  basic_function(basic_function&& other) {
+    move_storage(other);
+    set_descriptor(other.desc);
   }
 
+  // unique_function -> function, только если объект был сохранен с тегом
+  // copyable_storage, иначе бросает bad_function_conversion
+  template <bool I>
+    requires Copyable
+  explicit basic_function(
+      basic_function<R(Args...), false, Size, Align, I>&& other) {
+    if (!other.desc->copyable) {
+      throw bad_function_conversion{};
+    }
+    move_storage(other);
+    set_descriptor(static_cast<copy_descriptor_t const*>(other.desc));
+    other.destroy_storage();
+    other.set_descriptor(copy_descriptor_t::get_empty_descriptor());
+  }
+
+  // Наследники (function<F>) копируются и перемещаются, а не оборачиваются
   template <typename T>
-  function(T val)
-      : desc(descriptor::type_descriptor<R, Args...>::template get_descriptor<
-             T>()) {
-    if constexpr (details::fits_small<T>) {
-      new (&storage) T(std::move(val));
+    requires(!std::is_base_of_v<basic_function, T> &&
+             (!Copyable || std::is_copy_constructible_v<T>))
+  basic_function(T val) {
+    if constexpr (fits_small<T, storage_t>) {
+      construct_small(storage, std::move(val));
     } else {
       auto ptr = new T(std::move(val));
       new (&storage) T*(ptr);
     }
+    set_descriptor(descriptor_t::template get_descriptor<T>());
+  }
+
+  // См. copyable_storage_t
+  template <typename T>
+    requires(!Copyable && std::is_copy_constructible_v<T>)
+  basic_function(copyable_storage_t, T val) {
+    if constexpr (fits_small<T, storage_t>) {
+      construct_small(storage, std::move(val));
+    } else {
+      new (&storage) T*(new T(std::move(val)));
+    }
+    set_descriptor(copy_descriptor_t::template get_descriptor<T>());
+  }
+
+  // Большие объекты размещаются через alloc (в том числе при копировании),
+  // маленькие по-прежнему хранятся в буфере
+  template <typename Alloc, typename T>
+    requires(!Copyable || std::is_copy_constructible_v<T>)
+  basic_function(std::allocator_arg_t, Alloc const& alloc, T val) {
+    if constexpr (fits_small<T, storage_t>) {
+      construct_small(storage, std::move(val));
+      set_descriptor(descriptor_t::template get_descriptor<T>());
+    } else {
+      new (&storage) allocated<T, Alloc>*(
+          allocated<T, Alloc>::create(alloc, std::move(val)));
+      set_descriptor(
+          descriptor_t::template get_allocated_descriptor<T, Alloc>());
+    }
+  }
+
+  // Копии разделяют один объект, пока к нему не обратятся через
+  // неконстантный target<T>(). Маленькие объекты хранятся в буфере как обычно
+  template <typename T>
+    requires(Copyable && std::is_copy_constructible_v<T>)
+  basic_function(shared_storage_t, T val) {
+    if constexpr (fits_small<T, storage_t>) {
+      construct_small(storage, std::move(val));
+      set_descriptor(descriptor_t::template get_descriptor<T>());
+    } else {
+      new (&storage) shared<T>*(new shared<T>(std::move(val)));
+      set_descriptor(descriptor_t::template get_shared_descriptor<T>());
+    }
   }
 
-  function& operator=(function const& rhs) {
+  basic_function& operator=(basic_function const& rhs)
+    requires Copyable
+  {
     if (this != &rhs) {
-      function(rhs).swap(*this);
+      basic_function(rhs).swap(*this);
     }
     return *this;
   }
 
-  function& operator=(function&& rhs) noexcept {
+  basic_function& operator=(basic_function&& rhs) noexcept {
     if (this != &rhs) {
-      desc->destroy(storage);
-      rhs.desc->move(rhs.storage, storage);
-      desc = rhs.desc;
+      destroy_storage();
+      move_storage(rhs);
+      set_descriptor(rhs.desc);
     }
     return *this;
   }
 
-  ~function() {
-    desc->destroy(storage);
+  ~basic_function() {
+    destroy_storage();
   }
 
   explicit operator bool() const noexcept {
-    return descriptor::type_descriptor<R, Args...>::get_empty_descriptor() !=
-           desc;
+    return copy_descriptor_t::get_empty_descriptor() != desc;
   }
 
   R operator()(Args... args) const {
-    return desc->invoke(storage, std::forward<Args>(args)...);
+    if constexpr (InlineInvoke) {
+      return invoke(storage, std::forward<Args>(args)...);
+    } else {
+      return desc->invoke(storage, std::forward<Args>(args)...);
+    }
   }
 
+  // Для разделяемого объекта (shared_storage) делает собственную копию;
+  // если копирование T бросает исключение, вызывается std::terminate
   template <typename T>
   T* target() noexcept {
     if (!check_descriptor<T>()) {
       return nullptr;
     }
 
-    if constexpr (details::fits_small<T>) {
-      return details::get_func<T>(&storage);
+    if constexpr (fits_small<T, storage_t>) {
+      return get_func<T>(&storage);
     } else {
-      return details::get_func_from_ptr<T>(&storage);
+      if constexpr (Copyable && std::is_copy_constructible_v<T>) {
+        if (desc == descriptor_t::template get_shared_descriptor<T>()) {
+          *get_func<shared<T>*>(&storage) =
+              shared<T>::unshare(get_func_from_ptr<shared<T>>(&storage));
+        }
+      }
+      // описатели T различаются тем, где лежит объект
+      return static_cast<T*>(desc->object(storage));
     }
   }
 
@@ -191,27 +629,227 @@ struct function<R(Args...)> {
       return nullptr;
     }
 
-    if constexpr (details::fits_small<T>) {
-      return details::get_func<T>(&storage);
+    if constexpr (fits_small<T, storage_t>) {
+      return get_func<T>(&storage);
     } else {
-      return details::get_func_from_ptr<T>(&storage);
+      return static_cast<T const*>(desc->object(storage));
     }
   }
 
-  void swap(function& other) {
+  void swap(basic_function& other) {
+    if (desc->trivial && other.desc->trivial) {
+      std::swap(storage, other.storage);
+      std::swap(desc, other.desc);
+      if constexpr (InlineInvoke) {
+        std::swap(invoke, other.invoke);
+      }
+      return;
+    }
     auto tmp = std::move(other);
     other = std::move(*this);
     *this = std::move(tmp);
   }
 
 private:
-  details::storage_t storage;
-  descriptor::type_descriptor<R, Args...> const* desc;
+  storage_t storage;
+  [[no_unique_address]] std::conditional_t<InlineInvoke, invoke_t, no_invoke>
+      invoke;
+  descriptor_t const* desc;
 
+  template <typename Other>
+  void move_storage(Other& other) noexcept {
+    if (other.desc->trivial) {
+      storage = other.storage;
+    } else {
+      other.desc->move(other.storage, storage);
+    }
+  }
+
+  void destroy_storage() noexcept {
+    if (!desc->trivial) {
+      desc->destroy(storage);
+    }
+  }
+
+  void set_descriptor(descriptor_t const* d) noexcept {
+    desc = d;
+    if constexpr (InlineInvoke) {
+      invoke = d->invoke;
+    }
+  }
+
+  // У T может быть несколько описателей (аллокатор, shared_storage,
+  // copyable_storage), поэтому сравниваются теги типа
   template <typename T>
-  bool check_descriptor() const {
-    return desc ==
-           descriptor::type_descriptor<R,
-                                       Args...>::template get_descriptor<T>();
+  bool check_descriptor() const noexcept {
+    return desc->type == &type_tag<T>::id;
   }
 };
+} // namespace details
+
+// function с буфером размера Size и выравнивания Align для хранения
+// небольших объектов без аллокации, function<F> -- буфер в одно слово.
+// InlineInvoke -- см. details::basic_function
+template <typename F, std::size_t Size = sizeof(void*),
+          std::size_t Align = alignof(void*), bool InlineInvoke = false>
+using function_sbo =
+    details::basic_function<F, true, Size, Align, InlineInvoke>;
+
+namespace details {
+// Несколько сигнатур: один объект в одном буфере, operator() для каждой
+// сигнатуры, перегрузка выбирается при компиляции
+template <typename... Fs>
+struct multi_function;
+
+template <typename Derived, std::size_t I, typename F>
+struct call_operator;
+
+template <typename Derived, std::size_t I, typename R, typename... Args>
+struct call_operator<Derived, I, R(Args...)> {
+  R operator()(Args... args) const {
+    auto const& self = static_cast<Derived const&>(*this);
+    return std::get<I>(self.desc->invokes)(self.storage,
+                                           std::forward<Args>(args)...);
+  }
+};
+
+template <typename Derived, typename Indices, typename... Fs>
+struct call_operators;
+
+template <typename Derived, std::size_t... Is, typename... Fs>
+struct call_operators<Derived, std::index_sequence<Is...>, Fs...>
+    : call_operator<Derived, Is, Fs>... {
+  using call_operator<Derived, Is, Fs>::operator()...;
+};
+
+template <typename... Fs>
+struct multi_function
+    : call_operators<multi_function<Fs...>, std::index_sequence_for<Fs...>,
+                     Fs...> {
+private:
+  using descriptor_t = descriptor::multi_descriptor<storage_t, Fs...>;
+
+  template <typename Derived, std::size_t I, typename F>
+  friend struct call_operator;
+
+  template <typename T>
+  static constexpr bool storable =
+      std::is_copy_constructible_v<T> &&
+      (descriptor::invoker<storage_t, Fs>::template accepts<T> && ...);
+
+public:
+  multi_function() noexcept
+      : storage{}, desc(descriptor_t::get_empty_descriptor()) {}
+
+  multi_function(multi_function const& other) : desc(other.desc) {
+    if (desc->trivial) {
+      storage = other.storage;
+    } else {
+      desc->copy(other.storage, storage);
+    }
+  }
+
+  multi_function(multi_function&& other) noexcept : desc(other.desc) {
+    move_storage(other);
+  }
+
+  template <typename T>
+    requires(!std::is_same_v<T, multi_function> && storable<T>)
+  multi_function(T val) : desc(descriptor_t::template get_descriptor<T>()) {
+    if constexpr (fits_small<T, storage_t>) {
+      construct_small(storage, std::move(val));
+    } else {
+      new (&storage) T*(new T(std::move(val)));
+    }
+  }
+
+  multi_function& operator=(multi_function const& rhs) {
+    if (this != &rhs) {
+      multi_function(rhs).swap(*this);
+    }
+    return *this;
+  }
+
+  multi_function& operator=(multi_function&& rhs) noexcept {
+    if (this != &rhs) {
+      destroy_storage();
+      desc = rhs.desc;
+      move_storage(rhs);
+    }
+    return *this;
+  }
+
+  ~multi_function() {
+    destroy_storage();
+  }
+
+  explicit operator bool() const noexcept {
+    return descriptor_t::get_empty_descriptor() != desc;
+  }
+
+  template <typename T>
+  T* target() noexcept {
+    return const_cast<T*>(std::as_const(*this).template target<T>());
+  }
+
+  // Объект типа, не подходящего под сигнатуры, храниться не может
+  template <typename T>
+  T const* target() const noexcept {
+    if constexpr (!storable<T>) {
+      return nullptr;
+    } else {
+      if (desc != descriptor_t::template get_descriptor<T>()) {
+        return nullptr;
+      }
+      if constexpr (fits_small<T, storage_t>) {
+        return get_func<T>(&storage);
+      } else {
+        return get_func_from_ptr<T>(&storage);
+      }
+    }
+  }
+
+  void swap(multi_function& other) noexcept {
+    multi_function tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+private:
+  storage_t storage;
+  descriptor_t const* desc;
+
+  void move_storage(multi_function& other) noexcept {
+    if (desc->trivial) {
+      storage = other.storage;
+    } else {
+      desc->move(other.storage, storage);
+    }
+  }
+
+  void destroy_storage() noexcept {
+    if (!desc->trivial) {
+      desc->destroy(storage);
+    }
+  }
+};
+
+} // namespace details
+
+// function_sbo с буфером в одно слово. Отдельный класс, а не псевдоним, чтобы
+// R и Args выводились из параметра function<R(Args...)>
+template <typename F>
+struct function : function_sbo<F> {
+  using function_sbo<F>::function_sbo;
+};
+
+// Один объект с несколькими сигнатурами Fs...
+template <typename... Fs>
+using multi_function = details::multi_function<Fs...>;
+
+// Как function, но принимает и некопируемые объекты, а сам только
+// перемещается
+template <typename F, std::size_t Size = sizeof(void*),
+          std::size_t Align = alignof(void*), bool InlineInvoke = false>
+using unique_function =
+    details::basic_function<F, false, Size, Align, InlineInvoke>;
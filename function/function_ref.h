@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Невладеющая ссылка на вызываемый объект: указатель на объект и функция,
+// которая его вызывает. Ничего не аллоцирует, тривиально копируется.
+// Объект должен жить, пока используется function_ref (временный объект в
+// аргументе функции живет до конца вызова).
+template <typename F>
+struct function_ref;
+
+template <typename R, typename... Args>
+struct function_ref<R(Args...)> {
+  template <typename T>
+    requires(!std::is_same_v<std::remove_cvref_t<T>, function_ref> &&
+             std::is_invocable_r_v<R, T&, Args...>)
+  function_ref(T&& f) noexcept {
+    using U = std::remove_reference_t<T>;
+    if constexpr (std::is_function_v<std::remove_pointer_t<U>>) {
+      // указатель на функцию нельзя хранить в void*
+      std::remove_pointer_t<U>* fp = f;
+      ptr.fn = reinterpret_cast<void (*)()>(fp);
+      invoke = [](callable c, Args... args) -> R {
+        auto fn = reinterpret_cast<std::remove_pointer_t<U>*>(c.fn);
+        // для R = void результат отбрасывается
+        if constexpr (std::is_void_v<R>) {
+          fn(std::forward<Args>(args)...);
+        } else {
+          return fn(std::forward<Args>(args)...);
+        }
+      };
+    } else {
+      ptr.obj = const_cast<void*>(static_cast<void const*>(std::addressof(f)));
+      invoke = [](callable c, Args... args) -> R {
+        if constexpr (std::is_void_v<R>) {
+          std::invoke(*static_cast<U*>(c.obj), std::forward<Args>(args)...);
+        } else {
+          return std::invoke(*static_cast<U*>(c.obj),
+                             std::forward<Args>(args)...);
+        }
+      };
+    }
+  }
+
+  R operator()(Args... args) const {
+    return invoke(ptr, std::forward<Args>(args)...);
+  }
+
+private:
+  union callable {
+    void* obj;
+    void (*fn)();
+  };
+
+  callable ptr;
+  R (*invoke)(callable c, Args... args);
+};
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Набор вызываемых объектов для пакетного вызова. Объекты одного типа лежат
+// подряд в своем массиве (группе) и вызываются в одном цикле через один
+// описатель, поэтому косвенный переход внутри группы предсказуем, а обход --
+// последовательный.
+// Порядок вызова -- по группам (в порядке появления типов), внутри группы
+// порядок не сохраняется при erase.
+template <typename F>
+struct function_vector;
+
+namespace details {
+template <typename... Args>
+struct group_descriptor {
+  std::size_t size;
+  std::size_t align;
+  void (*invoke_all)(std::byte const* data, std::size_t n, Args&... args);
+  // перемещает n объектов из src в dst и уничтожает их в src
+  void (*relocate)(std::byte* src, std::byte* dst, std::size_t n) noexcept;
+  void (*destroy)(std::byte* data, std::size_t n) noexcept;
+
+  template <typename T>
+  static group_descriptor const* get_descriptor() noexcept {
+    constexpr static group_descriptor result = {
+        sizeof(T), alignof(T),
+        [](std::byte const* data, std::size_t n, Args&... args) {
+          // invoke_all
+          T const* objs = reinterpret_cast<T const*>(data);
+          for (std::size_t i = 0; i < n; i++) {
+            std::invoke(objs[i], args...);
+          }
+        },
+        [](std::byte* src, std::byte* dst, std::size_t n) noexcept {
+          // relocate
+          T* from = reinterpret_cast<T*>(src);
+          T* to = reinterpret_cast<T*>(dst);
+          for (std::size_t i = 0; i < n; i++) {
+            new (to + i) T(std::move(from[i]));
+            from[i].~T();
+          }
+        },
+        [](std::byte* data, std::size_t n) noexcept {
+          // destroy
+          T* objs = reinterpret_cast<T*>(data);
+          for (std::size_t i = 0; i < n; i++) {
+            objs[i].~T();
+          }
+        }};
+    return &result;
+  }
+};
+} // namespace details
+
+template <typename... Args>
+struct function_vector<void(Args...)> {
+  // Действителен до erase этого элемента или clear
+  struct handle {
+    std::size_t group;
+    std::size_t id;
+
+    friend bool operator==(handle const&, handle const&) = default;
+  };
+
+  function_vector() = default;
+
+  function_vector(function_vector&& other) noexcept
+      : groups(std::move(other.groups)), size_(std::exchange(other.size_, 0)) {}
+
+  function_vector& operator=(function_vector&& other) noexcept {
+    if (this != &other) {
+      groups = std::move(other.groups);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  // Перемещение объекта не должно бросать: при росте группы и при erase
+  // объекты переезжают внутри массива
+  template <typename T>
+    requires(std::is_nothrow_move_constructible_v<T> &&
+             std::is_invocable_v<T const&, Args&...>)
+  handle append(T val) {
+    std::size_t g = find_group(descriptor::template get_descriptor<T>());
+    group& gr = groups[g];
+    gr.reserve(gr.size + 1);
+    new (gr.at(gr.size)) T(std::move(val));
+    ++size_;
+    return {g, gr.add_id()};
+  }
+
+  void erase(handle h) noexcept {
+    groups[h.group].erase(h.id);
+    --size_;
+  }
+
+  void invoke_all(Args... args) const {
+    for (group const& gr : groups) {
+      if (gr.size != 0) {
+        gr.desc->invoke_all(gr.data, gr.size, args...);
+      }
+    }
+  }
+
+  void clear() noexcept {
+    for (group& gr : groups) {
+      gr.clear();
+    }
+    size_ = 0;
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+private:
+  using descriptor = details::group_descriptor<Args...>;
+
+  struct group {
+    explicit group(descriptor const* desc) : desc(desc) {}
+
+    group(group&& other) noexcept
+        : desc(other.desc), data(std::exchange(other.data, nullptr)),
+          size(std::exchange(other.size, 0)),
+          capacity(std::exchange(other.capacity, 0)),
+          id_of(std::move(other.id_of)), pos_of(std::move(other.pos_of)),
+          free_ids(std::move(other.free_ids)) {}
+
+    group& operator=(group&& other) noexcept {
+      if (this != &other) {
+        free_data();
+        desc = other.desc;
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        capacity = std::exchange(other.capacity, 0);
+        id_of = std::move(other.id_of);
+        pos_of = std::move(other.pos_of);
+        free_ids = std::move(other.free_ids);
+      }
+      return *this;
+    }
+
+    ~group() {
+      free_data();
+    }
+
+    std::byte* at(std::size_t pos) const noexcept {
+      return data + pos * desc->size;
+    }
+
+    // После reserve(n) добавление до n элементов не бросает
+    void reserve(std::size_t n) {
+      if (n <= capacity) {
+        return;
+      }
+      std::size_t new_capacity = std::max(n, capacity * 2);
+      id_of.reserve(new_capacity);
+      pos_of.reserve(new_capacity);
+      free_ids.reserve(new_capacity);
+      auto* new_data = static_cast<std::byte*>(::operator new(
+          new_capacity * desc->size, std::align_val_t(desc->align)));
+      if (data) {
+        desc->relocate(data, new_data, size);
+        ::operator delete(data, std::align_val_t(desc->align));
+      }
+      data = new_data;
+      capacity = new_capacity;
+    }
+
+    // Регистрирует только что созданный последний элемент
+    std::size_t add_id() noexcept {
+      std::size_t id;
+      if (free_ids.empty()) {
+        id = pos_of.size();
+        pos_of.push_back(size);
+      } else {
+        id = free_ids.back();
+        free_ids.pop_back();
+        pos_of[id] = size;
+      }
+      id_of.push_back(id);
+      ++size;
+      return id;
+    }
+
+    // На место удаленного переезжает последний элемент
+    void erase(std::size_t id) noexcept {
+      std::size_t pos = pos_of[id];
+      std::size_t last = size - 1;
+      desc->destroy(at(pos), 1);
+      if (pos != last) {
+        desc->relocate(at(last), at(pos), 1);
+        id_of[pos] = id_of[last];
+        pos_of[id_of[pos]] = pos;
+      }
+      id_of.pop_back();
+      free_ids.push_back(id);
+      --size;
+    }
+
+    void clear() noexcept {
+      desc->destroy(data, size);
+      size = 0;
+      id_of.clear();
+      pos_of.clear();
+      free_ids.clear();
+    }
+
+    void free_data() noexcept {
+      if (data) {
+        desc->destroy(data, size);
+        ::operator delete(data, std::align_val_t(desc->align));
+      }
+    }
+
+    descriptor const* desc;
+    std::byte* data = nullptr;
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+    // позиция -> id и id -> позиция, free_ids -- id удаленных элементов
+    std::vector<std::size_t> id_of;
+    std::vector<std::size_t> pos_of;
+    std::vector<std::size_t> free_ids;
+  };
+
+  // Типов обычно немного, поэтому поиск линейный
+  std::size_t find_group(descriptor const* desc) {
+    for (std::size_t i = 0; i < groups.size(); i++) {
+      if (groups[i].desc == desc) {
+        return i;
+      }
+    }
+    groups.emplace_back(desc);
+    return groups.size() - 1;
+  }
+
+  std::vector<group> groups;
+  std::size_t size_ = 0;
+};
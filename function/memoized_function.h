@@ -0,0 +1,318 @@
+#pragma once
+
+#include "function.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace memo {
+struct stats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t evictions = 0;
+
+  double hit_rate() const noexcept {
+    std::size_t calls = hits + misses;
+    return calls == 0 ? 0 : static_cast<double>(hits) / calls;
+  }
+
+  stats& operator+=(stats const& other) noexcept {
+    hits += other.hits;
+    misses += other.misses;
+    evictions += other.evictions;
+    return *this;
+  }
+};
+
+// Сведения о ячейке, по которым политика выбирает, кого вытеснить
+struct slot_info {
+  std::uint64_t last_use;
+  std::uint64_t uses;
+};
+
+// Политики вытеснения: victim выбирает ячейку среди n занятых ячеек группы
+struct lru {
+  static std::size_t victim(slot_info const* slots, std::size_t n,
+                            std::uint64_t&) noexcept {
+    std::size_t res = 0;
+    for (std::size_t i = 1; i < n; i++) {
+      if (slots[i].last_use < slots[res].last_use) {
+        res = i;
+      }
+    }
+    return res;
+  }
+};
+
+struct lfu {
+  static std::size_t victim(slot_info const* slots, std::size_t n,
+                            std::uint64_t&) noexcept {
+    std::size_t res = 0;
+    for (std::size_t i = 1; i < n; i++) {
+      if (slots[i].uses < slots[res].uses ||
+          (slots[i].uses == slots[res].uses &&
+           slots[i].last_use < slots[res].last_use)) {
+        res = i;
+      }
+    }
+    return res;
+  }
+};
+
+struct random {
+  static std::size_t victim(slot_info const*, std::size_t n,
+                            std::uint64_t& state) noexcept {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state % n;
+  }
+};
+
+template <typename... Ts>
+std::size_t hash_args(Ts const&... args) {
+  std::size_t res = 0;
+  ((res ^= std::hash<Ts>()(args) + 0x9E3779B97F4A7C15ull + (res << 6) +
+           (res >> 2)),
+   ...);
+  // std::hash для целых -- тождественная функция, а шард выбирается по
+  // старшим битам: перемешиваем (финализатор murmur3)
+  std::uint64_t h = res;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  h ^= h >> 33;
+  return static_cast<std::size_t>(h);
+}
+
+// Открытая адресация с линейным пробированием, ограниченным группой из ways
+// ячеек: поиск и вставка смотрят не больше ways ячеек, при переполнении
+// группы Eviction выбирает, кого заменить. Ячеек больше, чем capacity, но
+// живых записей не больше capacity. Записи группы лежат подряд с ее начала:
+// поиск останавливается на первой пустой ячейке
+template <typename Key, typename Value, typename Eviction>
+struct table {
+  static constexpr std::size_t ways = 8;
+
+  explicit table(std::size_t capacity) : limit(capacity) {
+    std::size_t groups = 1;
+    while (groups * ways < capacity) {
+      groups *= 2;
+    }
+    mask = groups - 1;
+    slots.resize(groups * ways);
+    info.resize(groups * ways);
+  }
+
+  std::size_t capacity() const noexcept {
+    return limit;
+  }
+
+  std::size_t size() const noexcept {
+    return live;
+  }
+
+  Value const* find(std::size_t hash, Key const& key) {
+    std::size_t first = group(hash);
+    for (std::size_t i = first; i < first + ways; i++) {
+      if (!slots[i]) {
+        break;
+      }
+      if (slots[i]->hash == hash && slots[i]->key == key) {
+        info[i].last_use = ++tick;
+        ++info[i].uses;
+        ++counters.hits;
+        return &slots[i]->value;
+      }
+    }
+    ++counters.misses;
+    return nullptr;
+  }
+
+  void insert(std::size_t hash, Key key, Value value) {
+    std::size_t first = group(hash);
+    std::size_t pos = first;
+    while (pos < first + ways && slots[pos]) {
+      if (slots[pos]->hash == hash && slots[pos]->key == key) {
+        // значение уже посчитал другой поток
+        return;
+      }
+      ++pos;
+    }
+    if (pos == first + ways) {
+      pos = first + Eviction::victim(&info[first], ways, rng);
+      ++counters.evictions;
+    } else if (live < limit) {
+      ++live;
+    } else if (pos != first) {
+      // записей уже limit: заменяем одну из своей группы
+      pos = first + Eviction::victim(&info[first], pos - first, rng);
+      ++counters.evictions;
+    } else if (limit != 0) {
+      // своя группа пуста -- вытесняем из ближайшей непустой
+      evict_after(first);
+      ++counters.evictions;
+    } else {
+      return;
+    }
+    slots[pos].emplace(hash, std::move(key), std::move(value));
+    info[pos] = {++tick, 1};
+  }
+
+  stats counters;
+
+private:
+  struct entry {
+    entry(std::size_t hash, Key key, Value value)
+        : hash(hash), key(std::move(key)), value(std::move(value)) {}
+
+    std::size_t hash;
+    Key key;
+    Value value;
+  };
+
+  std::size_t group(std::size_t hash) const noexcept {
+    // старшие биты выбирают шард, здесь берем младшие
+    return (hash & mask) * ways;
+  }
+
+  void evict_after(std::size_t first) {
+    std::size_t g = first;
+    do {
+      g = (g + ways) % slots.size();
+    } while (!slots[g]);
+    std::size_t n = 1;
+    while (n < ways && slots[g + n]) {
+      ++n;
+    }
+    // на место жертвы ставим последнюю запись группы, чтобы не было дыр
+    std::size_t victim = g + Eviction::victim(&info[g], n, rng);
+    std::size_t last = g + n - 1;
+    if (victim != last) {
+      slots[victim].reset();
+      slots[victim].emplace(std::move(*slots[last]));
+      info[victim] = info[last];
+    }
+    slots[last].reset();
+  }
+
+  std::vector<std::optional<entry>> slots;
+  std::vector<slot_info> info;
+  std::size_t mask;
+  std::size_t limit;
+  std::size_t live = 0;
+  std::uint64_t tick = 0;
+  std::uint64_t rng = 0x9E3779B97F4A7C15ull;
+};
+} // namespace memo
+
+// Кэширует результаты чистой функции по значениям аргументов. Кэш хранит не
+// больше capacity записей (capacity делится между шардами), вытеснение -- по
+// Eviction (memo::lru, memo::lfu, memo::random).
+// Concurrent = false -- без синхронизации, одновременные вызовы запрещены.
+// Concurrent = true -- кэш разбит на шарды со своими мьютексами, функция
+// вычисляется вне блокировки.
+template <typename F, typename Eviction = memo::lru, bool Concurrent = false>
+struct memoized_function;
+
+template <typename R, typename... Args, typename Eviction, bool Concurrent>
+struct memoized_function<R(Args...), Eviction, Concurrent> {
+  using key_t = std::tuple<std::decay_t<Args>...>;
+  using value_t = std::decay_t<R>;
+
+  static_assert(!std::is_void_v<R>, "nothing to memoize");
+
+  explicit memoized_function(function<R(Args...)> f, std::size_t capacity,
+                             std::size_t shards = Concurrent ? 16 : 1)
+      : f(std::move(f)) {
+    shards = std::max<std::size_t>(shards, 1);
+    std::size_t n = 1;
+    while (n < shards) {
+      n *= 2;
+    }
+    shard_bits = std::countr_zero(n);
+    for (std::size_t i = 0; i < n; i++) {
+      std::size_t part = capacity / n + (i < capacity % n ? 1 : 0);
+      parts.push_back(std::make_unique<shard>(part));
+    }
+  }
+
+  value_t operator()(Args... args) const {
+    std::size_t hash = memo::hash_args(args...);
+    shard& s = *parts[shard_of(hash)];
+    key_t key(args...);
+    {
+      lock_t lock(s.mutex);
+      if (value_t const* cached = s.cache.find(hash, key)) {
+        return *cached;
+      }
+    }
+    value_t res = f(std::forward<Args>(args)...);
+    lock_t lock(s.mutex);
+    s.cache.insert(hash, std::move(key), res);
+    return res;
+  }
+
+  memo::stats stats() const {
+    memo::stats res;
+    for (auto const& s : parts) {
+      lock_t lock(s->mutex);
+      res += s->cache.counters;
+    }
+    return res;
+  }
+
+  std::size_t capacity() const noexcept {
+    std::size_t res = 0;
+    for (auto const& s : parts) {
+      res += s->cache.capacity();
+    }
+    return res;
+  }
+
+  std::size_t size() const {
+    std::size_t res = 0;
+    for (auto const& s : parts) {
+      lock_t lock(s->mutex);
+      res += s->cache.size();
+    }
+    return res;
+  }
+
+private:
+  struct no_mutex {
+    void lock() noexcept {}
+    void unlock() noexcept {}
+  };
+
+  using mutex_t = std::conditional_t<Concurrent, std::mutex, no_mutex>;
+  using lock_t = std::lock_guard<mutex_t>;
+
+  struct shard {
+    explicit shard(std::size_t capacity) : cache(capacity) {}
+
+    mutex_t mutex;
+    memo::table<key_t, value_t, Eviction> cache;
+  };
+
+  std::size_t shard_of(std::size_t hash) const noexcept {
+    return shard_bits == 0 ? 0 : hash >> (sizeof(hash) * 8 - shard_bits);
+  }
+
+  function<R(Args...)> f;
+  // шарды и кэши меняются в константном operator()
+  std::vector<std::unique_ptr<shard>> parts;
+  std::size_t shard_bits;
+};
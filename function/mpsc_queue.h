@@ -0,0 +1,151 @@
+#pragma once
+
+#include "function.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+
+// Очередь задач: много производителей, один потребитель. Кольцо слотов,
+// каждый слот содержит unique_function с буфером на Size байт, поэтому
+// постановка небольшой лямбды ничего не аллоцирует.
+// Производитель получает номер слота одним fetch_add и, если кольцо полно,
+// ждет, пока потребитель освободит этот слот. Потребитель выполняет задачи
+// прямо в слотах, пачками, в порядке номеров.
+template <std::size_t Size = 6 * sizeof(void*)>
+struct mpsc_queue {
+  using task = unique_function<void(), Size>;
+
+  // capacity округляется вверх до степени двойки
+  explicit mpsc_queue(std::size_t capacity) {
+    std::size_t n = 1;
+    while (n < capacity) {
+      n *= 2;
+    }
+    mask = n - 1;
+    slots = std::make_unique<slot[]>(n);
+    for (std::size_t i = 0; i < n; i++) {
+      slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_queue(mpsc_queue const&) = delete;
+  mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+  // Любой поток. Блокируется, если очередь полна
+  template <typename F>
+  void push(F&& f) {
+    // объект создается до получения номера: если конструктор бросит,
+    // слот не останется занятым навсегда
+    task t(std::forward<F>(f));
+    std::uint64_t pos = tail.fetch_add(1, std::memory_order_relaxed);
+    slot& s = slots[pos & mask];
+    if (s.seq.load(std::memory_order_acquire) != pos) {
+      wait_for(s, pos, producers_waiting);
+    }
+    s.fn = std::move(t);
+    s.seq.store(pos + 1);
+    if (consumer_waiting.load() != 0) {
+      s.seq.notify_all();
+    }
+  }
+
+  // Только потребитель. Выполняет до max готовых задач, возвращает их
+  // количество. Если задача бросила, исключение выходит наружу, а
+  // оставшиеся задачи остаются в очереди.
+  // Задача не должна ставить в эту же очередь, если та может быть полна:
+  // слоты освобождает только потребитель, и push повиснет навсегда
+  std::size_t drain(std::size_t max = std::numeric_limits<std::size_t>::max()) {
+    batch_guard batch{this, head};
+    while (head - batch.first < max) {
+      slot& s = slots[head & mask];
+      if (s.seq.load(std::memory_order_acquire) != head + 1) {
+        break;
+      }
+      release_guard guard{this, s};
+      s.fn();
+    }
+    return head - batch.first;
+  }
+
+  // Только потребитель. Ждет, пока в голове очереди появится задача
+  void wait() {
+    slot& s = slots[head & mask];
+    if (s.seq.load(std::memory_order_acquire) != head + 1) {
+      wait_for(s, head + 1, consumer_waiting);
+    }
+  }
+
+  // Только потребитель
+  bool empty() const noexcept {
+    return slots[head & mask].seq.load(std::memory_order_acquire) != head + 1;
+  }
+
+  std::size_t capacity() const noexcept {
+    return mask + 1;
+  }
+
+private:
+  // seq == номер -- слот свободен для производителя с этим номером,
+  // seq == номер + 1 -- задача с этим номером готова
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> seq;
+    task fn;
+  };
+
+  // Освобождает слот в голове, в том числе после исключения из задачи.
+  // Ожидающих производителей будит batch_guard
+  struct release_guard {
+    ~release_guard() {
+      s.fn = task();
+      s.seq.store(q->head + q->mask + 1, std::memory_order_release);
+      ++q->head;
+    }
+
+    mpsc_queue* q;
+    slot& s;
+  };
+
+  // Одна проверка ожидающих производителей на весь drain
+  struct batch_guard {
+    ~batch_guard() {
+      if (q->head == first) {
+        return;
+      }
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (q->producers_waiting.load() != 0) {
+        for (std::uint64_t i = first; i != q->head; i++) {
+          q->slots[i & q->mask].seq.notify_all();
+        }
+      }
+    }
+
+    mpsc_queue* q;
+    std::uint64_t first;
+  };
+
+  // Ожидающие отмечаются в waiting, поэтому без ожидающих публикация не
+  // тратит время на notify. Запись seq и проверка waiting упорядочены
+  // (seq_cst), как и отметка и повторная проверка у ожидающего: хотя бы одна
+  // сторона увидит другую
+  template <typename Counter>
+  static void wait_for(slot& s, std::uint64_t expected,
+                       std::atomic<Counter>& waiting) {
+    waiting.fetch_add(1);
+    for (std::uint64_t seq = s.seq.load(); seq != expected; seq = s.seq.load()) {
+      s.seq.wait(seq);
+    }
+    waiting.fetch_sub(1);
+  }
+
+  std::unique_ptr<slot[]> slots;
+  std::size_t mask;
+  alignas(64) std::atomic<std::uint64_t> tail{0};
+  alignas(64) std::atomic<std::size_t> producers_waiting{0};
+  std::atomic<std::size_t> consumer_waiting{0};
+  // пишет только потребитель
+  alignas(64) std::uint64_t head{0};
+};
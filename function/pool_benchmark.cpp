@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Пропускная способность и задержка thread_pool для 1..64 рабочих:
+//   fan-out  -- дерево submit/get внутри пула (свои деки и перехват),
+//   external -- задачи ставит внешний поток (общая очередь без блокировок,
+//               рабочие забирают ее пачками),
+//   latency  -- submit + get из внешнего потока при простаивающем пуле.
+namespace {
+template <typename T>
+void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using clock_type = std::chrono::steady_clock;
+
+double ns_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+// Полезная работа задачи: tiny -- несколько наносекунд, medium -- единицы
+// микросекунд
+std::uint64_t work(std::uint64_t seed, int rounds) {
+  for (int i = 0; i < rounds; i++) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  return seed;
+}
+
+std::uint64_t fan_out(thread_pool& pool, std::size_t from, std::size_t to,
+                      int rounds) {
+  if (to - from == 1) {
+    return work(from, rounds);
+  }
+  std::size_t mid = from + (to - from) / 2;
+  auto left = pool.submit(
+      [&pool, from, mid, rounds] { return fan_out(pool, from, mid, rounds); });
+  std::uint64_t right = fan_out(pool, mid, to, rounds);
+  return left.get() ^ right;
+}
+
+double run_fan_out(thread_pool& pool, std::size_t tasks, int rounds) {
+  auto start = clock_type::now();
+  auto res = pool.submit(
+      [&pool, tasks, rounds] { return fan_out(pool, 0, tasks, rounds); });
+  do_not_optimize(res.get());
+  return ns_since(start) / tasks;
+}
+
+double run_external(thread_pool& pool, std::size_t tasks, int rounds) {
+  std::atomic<std::size_t> remaining{tasks};
+  auto start = clock_type::now();
+  for (std::size_t i = 0; i < tasks; i++) {
+    pool.execute([&remaining, i, rounds] {
+      do_not_optimize(work(i, rounds));
+      if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        remaining.notify_one();
+      }
+    });
+  }
+  for (std::size_t r = remaining.load(); r != 0; r = remaining.load()) {
+    remaining.wait(r);
+  }
+  return ns_since(start) / tasks;
+}
+
+double run_latency(thread_pool& pool, std::size_t rounds) {
+  double total = 0;
+  for (std::size_t i = 0; i < rounds; i++) {
+    auto start = clock_type::now();
+    pool.submit([] {}).get();
+    total += ns_since(start);
+  }
+  return total / rounds;
+}
+
+constexpr int tiny = 4;
+constexpr int medium = 2000;
+} // namespace
+
+int main() {
+  std::printf("%8s %16s %16s %16s %16s %12s\n", "workers", "fan-out tiny",
+              "fan-out medium", "external tiny", "external medium",
+              "latency");
+  std::printf("%8s %16s %16s %16s %16s %12s\n", "", "ns/task", "ns/task",
+              "ns/task", "ns/task", "ns");
+  for (std::size_t workers = 1; workers <= 64; workers *= 2) {
+    thread_pool pool(workers);
+    double fan_tiny = run_fan_out(pool, 1 << 20, tiny);
+    double fan_medium = run_fan_out(pool, 1 << 14, medium);
+    double ext_tiny = run_external(pool, 1 << 18, tiny);
+    double ext_medium = run_external(pool, 1 << 14, medium);
+    double latency = run_latency(pool, 10000);
+    std::printf("%8zu %16.1f %16.1f %16.1f %16.1f %12.1f\n", workers,
+                fan_tiny, fan_medium, ext_tiny, ext_medium, latency);
+  }
+}
@@ -0,0 +1,73 @@
+#include "profiling.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#ifdef FUNCTION_PROFILING
+namespace {
+// Записи -- статические объекты entry_of<T>, список только растет
+std::atomic<profiling::entry*> registry{nullptr};
+
+std::string demangle(char const* name) {
+#if __has_include(<cxxabi.h>)
+  int status = 0;
+  std::unique_ptr<char, void (*)(void*)> res(
+      abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+  if (status == 0) {
+    return res.get();
+  }
+#endif
+  return name;
+}
+} // namespace
+
+profiling::entry::entry(std::type_info const& type) noexcept : type(type) {
+  next = registry.load(std::memory_order_relaxed);
+  while (!registry.compare_exchange_weak(next, this, std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+  }
+}
+
+std::vector<profiling::record> profiling::snapshot() {
+  std::vector<record> res;
+  for (entry* e = registry.load(std::memory_order_acquire); e; e = e->next) {
+    res.push_back({demangle(e->type.name()),
+                   e->calls.load(std::memory_order_relaxed),
+                   e->ticks.load(std::memory_order_relaxed)});
+  }
+  std::sort(res.begin(), res.end(), [](record const& a, record const& b) {
+    return a.ticks > b.ticks;
+  });
+  return res;
+}
+
+void profiling::reset() {
+  for (entry* e = registry.load(std::memory_order_acquire); e; e = e->next) {
+    e->calls.store(0, std::memory_order_relaxed);
+    e->ticks.store(0, std::memory_order_relaxed);
+  }
+}
+#else
+std::vector<profiling::record> profiling::snapshot() {
+  return {};
+}
+
+void profiling::reset() {}
+#endif
+
+void profiling::dump(std::FILE* out) {
+  std::fprintf(out, "%12s %16s %12s  %s\n", "calls", "ticks", "ticks/call",
+               "type");
+  for (record const& r : snapshot()) {
+    std::fprintf(out, "%12llu %16llu %12.1f  %s\n",
+                 static_cast<unsigned long long>(r.calls),
+                 static_cast<unsigned long long>(r.ticks),
+                 r.calls == 0 ? 0.0 : static_cast<double>(r.ticks) / r.calls,
+                 r.name.c_str());
+  }
+}
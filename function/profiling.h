@@ -0,0 +1,30 @@
+#pragma once
+
+#include "profiling_scope.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Профилирование вызовов function по типам хранимых объектов. Включается
+// макросом FUNCTION_PROFILING, одинаковым для всех единиц трансляции: тогда
+// каждый invoke описателя считает вызовы и такты TSC (включая вложенные
+// вызовы). Без макроса scope -- пустой объект, invoke не меняется.
+// function.h подключает только profiling_scope.h, этот заголовок нужен тем,
+// кто выгружает результаты.
+namespace profiling {
+struct record {
+  std::string name;
+  std::uint64_t calls;
+  std::uint64_t ticks;
+};
+
+// Все типы, которые вызывались, по убыванию суммарного времени
+std::vector<record> snapshot();
+
+// Таблица snapshot() в out
+void dump(std::FILE* out = stderr);
+
+// Обнуляет счетчики, типы остаются в реестре
+void reset();
+} // namespace profiling
@@ -0,0 +1,63 @@
+#pragma once
+
+// Точка профилирования в invoke описателя function (см. profiling.h). Без
+// FUNCTION_PROFILING -- пустой объект и ни одного подключенного заголовка.
+#ifdef FUNCTION_PROFILING
+#include <atomic>
+#include <cstdint>
+#include <typeinfo>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace profiling {
+#ifdef FUNCTION_PROFILING
+struct entry {
+  explicit entry(std::type_info const& type) noexcept;
+
+  std::type_info const& type;
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> ticks{0};
+  entry* next = nullptr;
+};
+
+inline std::uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+template <typename T>
+entry& entry_of() noexcept {
+  // регистрируется при первом вызове объекта типа T
+  static entry result(typeid(T));
+  return result;
+}
+
+template <typename T>
+struct scope {
+  scope() noexcept : start(now()) {}
+
+  ~scope() {
+    entry& e = entry_of<T>();
+    e.ticks.fetch_add(now() - start, std::memory_order_relaxed);
+    e.calls.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  scope(scope const&) = delete;
+  scope& operator=(scope const&) = delete;
+
+private:
+  std::uint64_t start;
+};
+#else
+template <typename T>
+struct scope {};
+#endif
+} // namespace profiling
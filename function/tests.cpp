@@ -1,6 +1,22 @@
+#include "atomic_function.h"
 #include "function.h"
+#include "function_ref.h"
+#include "function_vector.h"
+#include "memoized_function.h"
+#include "mpsc_queue.h"
+#include "profiling.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
 TEST(function_test, default_ctor) {
   function<void()> x;
   function<void(int, int, int)> y;
@@ -146,6 +162,10 @@ struct large_func {
     assert(n_instances == 0);
   }
 
+  static size_t instances() {
+    return n_instances;
+  }
+
   int get_value() const {
     return value;
   }
@@ -340,6 +360,21 @@ struct bar {
   void operator()() const {}
 };
 
+namespace {
+template <typename R, typename... A>
+R call(function<R(A...)> const& f, A... args) {
+  return f(args...);
+}
+} // namespace
+
+TEST(function_test, deduce_signature) {
+  function<int(int, int)> f = [](int a, int b) { return a - b; };
+  EXPECT_EQ(3, call(f, 5, 2));
+  function<void()> g = [] {};
+  call(g);
+  static_assert(std::is_base_of_v<function_sbo<int(int, int)>, decltype(f)>);
+}
+
 TEST(function_test, target) {
   function<void()> f = foo();
   EXPECT_NE(nullptr, f.target<foo>());
@@ -351,6 +386,1045 @@ TEST(function_test, target) {
   EXPECT_NE(nullptr, f.target<bar>());
   EXPECT_EQ(nullptr, std::as_const(f).target<foo>());
   EXPECT_NE(nullptr, std::as_const(f).target<bar>());
+  static_assert(noexcept(f.target<foo>()));
+}
+
+template <typename T, typename F>
+bool stored_inline(F const& f) {
+  auto const* begin = reinterpret_cast<char const*>(&f);
+  auto const* p = reinterpret_cast<char const*>(f.template target<T>());
+  return begin <= p && p < begin + sizeof(F);
+}
+
+TEST(function_test, pointer_capture_is_small) {
+  int x = 42;
+  auto lambda = [&x] { return x; };
+  function<int()> f = lambda;
+  EXPECT_TRUE(stored_inline<decltype(lambda)>(f));
+  EXPECT_EQ(42, f());
+
+  using fptr = int (*)();
+  function<int()> g = static_cast<fptr>([] { return 43; });
+  EXPECT_TRUE(stored_inline<fptr>(g));
+  EXPECT_EQ(43, g());
+}
+
+TEST(function_sbo_test, buffer_size) {
+  long a = 1, b = 2, c = 3, d = 4;
+  auto lambda = [a, b, c, d] { return a + b + c + d; };
+  function_sbo<long(), 32> f = lambda;
+  function_sbo<long(), 16> g = lambda;
+  EXPECT_TRUE(stored_inline<decltype(lambda)>(f));
+  EXPECT_FALSE(stored_inline<decltype(lambda)>(g));
+
+  function_sbo<long(), 32> f_copy = f;
+  function_sbo<long(), 16> g_copy = g;
+  EXPECT_EQ(10, f_copy());
+  EXPECT_EQ(10, g_copy());
+  f_copy = std::move(f);
+  EXPECT_EQ(10, f_copy());
+}
+
+TEST(function_sbo_test, alignment) {
+  struct alignas(32) aligned_func {
+    int operator()() const {
+      return reinterpret_cast<std::uintptr_t>(this) % 32 == 0;
+    }
+  };
+  function_sbo<int(), 32, 32> f = aligned_func();
+  function_sbo<int(), 32> g = aligned_func();
+  EXPECT_TRUE(stored_inline<aligned_func>(f));
+  EXPECT_FALSE(stored_inline<aligned_func>(g));
+  EXPECT_EQ(1, f());
+  EXPECT_EQ(1, g());
+}
+
+TEST(unique_function_test, move_only) {
+  auto p = std::make_unique<int>(42);
+  unique_function<int()> f = [p = std::move(p)] { return *p; };
+  EXPECT_EQ(42, f());
+
+  unique_function<int()> g = std::move(f);
+  EXPECT_EQ(42, g());
+
+  unique_function<int()> h;
+  EXPECT_THROW(h(), bad_function_call);
+  h = std::move(g);
+  EXPECT_EQ(42, h());
+}
+
+TEST(unique_function_test, small_storage) {
+  auto p = std::make_unique<int>(42);
+  auto lambda = [p = std::move(p)] { return *p; };
+  using lambda_t = decltype(lambda);
+  unique_function<int()> f = std::move(lambda);
+  EXPECT_TRUE(stored_inline<lambda_t>(f));
+  EXPECT_EQ(42, f.target<lambda_t>()->operator()());
+}
+
+TEST(unique_function_test, large_func) {
+  {
+    unique_function<int()> f = large_func(42);
+    unique_function<int()> g = std::move(f);
+    EXPECT_EQ(42, g());
+    EXPECT_EQ(42, g.target<large_func>()->get_value());
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(unique_function_test, to_function) {
+  unique_function<int()> f(copyable_storage, small_func(42));
+  function<int()> g(std::move(f));
+  EXPECT_FALSE(static_cast<bool>(f));
+  function<int()> h = g;
+  EXPECT_EQ(42, h());
+  EXPECT_NE(nullptr, h.target<small_func>());
+
+  unique_function<int()> empty;
+  EXPECT_FALSE(static_cast<bool>(function<int()>(std::move(empty))));
+
+  unique_function<int()> u = [p = std::make_unique<int>(1)] { return *p; };
+  EXPECT_THROW(function<int()>(std::move(u)), bad_function_conversion);
+  EXPECT_EQ(1, u());
+
+  // копируемый объект без тега не преобразуется
+  unique_function<int()> c = small_func(42);
+  EXPECT_THROW(function<int()>(std::move(c)), bad_function_conversion);
+  EXPECT_EQ(42, c());
+}
+
+TEST(unique_function_test, copy_declared_but_ill_formed) {
+  // is_copy_constructible_v у такой лямбды true, но копирование не
+  // компилируется: unique_function не должен его инстанцировать
+  auto lambda = [v = std::vector<std::unique_ptr<int>>()] {
+    return static_cast<int>(v.size());
+  };
+  static_assert(std::is_copy_constructible_v<decltype(lambda)>);
+  unique_function<int()> f = std::move(lambda);
+  unique_function<int()> g = std::move(f);
+  EXPECT_EQ(0, g());
+}
+
+namespace {
+// Маленький объект с нетривиальными копированием и деструктором
+struct counted_func {
+  counted_func() noexcept {
+    ++live;
+  }
+
+  counted_func(counted_func const&) noexcept {
+    ++live;
+  }
+
+  ~counted_func() {
+    --live;
+  }
+
+  int operator()() const {
+    return 7;
+  }
+
+  static inline int live = 0;
+};
+} // namespace
+
+TEST(unique_function_test, to_function_destroys_source) {
+  {
+    unique_function<int()> u(copyable_storage, counted_func());
+    EXPECT_TRUE(stored_inline<counted_func>(u));
+    EXPECT_EQ(1, counted_func::live);
+    function<int()> f(std::move(u));
+    EXPECT_EQ(7, f());
+    EXPECT_EQ(1, counted_func::live);
+  }
+  EXPECT_EQ(0, counted_func::live);
+}
+
+static_assert(!std::is_copy_constructible_v<unique_function<void()>>);
+static_assert(!std::is_constructible_v<function<void()>,
+                                       decltype([p = std::unique_ptr<int>()] {})>);
+
+TEST(function_test, trivial_callables) {
+  int x = 40;
+  auto lambda = [x](int y) { return x + y; };
+  static_assert(std::is_trivially_copyable_v<decltype(lambda)>);
+
+  function<int(int)> f = lambda;
+  function<int(int)> g = f;
+  function<int(int)> h = std::move(g);
+  EXPECT_EQ(42, h(2));
+
+  function<int(int)> big = [payload = std::array<int, 100>{1}](int y) {
+    return payload[0] + y;
+  };
+  h.swap(big);
+  EXPECT_EQ(3, h(2));
+  EXPECT_EQ(42, big(2));
+  big.swap(f);
+  EXPECT_EQ(42, f(2));
+
+  function<int(int)> empty;
+  f.swap(empty);
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_EQ(42, empty(2));
+  EXPECT_NE(nullptr, empty.target<decltype(lambda)>());
+}
+
+namespace {
+struct counting_resource : std::pmr::memory_resource {
+  std::size_t allocated = 0;
+  std::size_t live = 0;
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    ++allocated;
+    ++live;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    --live;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+} // namespace
+
+TEST(function_test, allocator) {
+  counting_resource resource;
+  std::pmr::polymorphic_allocator<std::byte> alloc(&resource);
+  {
+    function<int()> f(std::allocator_arg, alloc, large_func(42));
+    EXPECT_EQ(1, resource.allocated);
+    EXPECT_EQ(42, f());
+    EXPECT_EQ(42, f.target<large_func>()->get_value());
+
+    function<int()> g = f;
+    EXPECT_EQ(2, resource.allocated);
+    function<int()> h = std::move(g);
+    EXPECT_EQ(2, resource.live);
+    EXPECT_EQ(42, h());
+
+    function<int()> small(std::allocator_arg, alloc, small_func(1));
+    EXPECT_EQ(2, resource.allocated);
+    EXPECT_EQ(1, small());
+  }
+  EXPECT_EQ(0, resource.live);
+  large_func::assert_no_instances();
+}
+
+namespace {
+// Большой объект, блок с которым не standard-layout
+struct polymorphic_func {
+  explicit polymorphic_func(int value) : value(value) {}
+  virtual ~polymorphic_func() = default;
+
+  virtual int operator()() const {
+    return value;
+  }
+
+  int value;
+  std::array<int, 8> payload{};
+};
+
+static_assert(!std::is_standard_layout_v<polymorphic_func>);
+} // namespace
+
+TEST(function_test, allocator_non_standard_layout) {
+  counting_resource resource;
+  std::pmr::polymorphic_allocator<std::byte> alloc(&resource);
+  {
+    function<int()> f(std::allocator_arg, alloc, polymorphic_func(7));
+    function<int()> g = f;
+    EXPECT_EQ(2, resource.live);
+    EXPECT_EQ(7, g());
+    g.target<polymorphic_func>()->value = 8;
+    EXPECT_EQ(8, g());
+    EXPECT_EQ(7, std::as_const(f).target<polymorphic_func>()->value);
+  }
+  EXPECT_EQ(0, resource.live);
+}
+
+TEST(unique_function_test, allocator) {
+  counting_resource resource;
+  std::pmr::polymorphic_allocator<std::byte> alloc(&resource);
+  {
+    auto p = std::make_unique<int>(42);
+    unique_function<int()> f(std::allocator_arg, alloc,
+                             [p = std::move(p), payload = std::array<int, 64>{}] {
+                               return *p + payload[0];
+                             });
+    unique_function<int()> g = std::move(f);
+    EXPECT_EQ(42, g());
+    EXPECT_EQ(1, resource.live);
+  }
+  EXPECT_EQ(0, resource.live);
+}
+
+TEST(function_test, shared_storage) {
+  {
+    function<int()> f(shared_storage, large_func(42));
+    function<int()> g = f;
+    function<int()> h;
+    h = g;
+    EXPECT_EQ(1, large_func::instances());
+    EXPECT_EQ(42, h());
+    EXPECT_EQ(std::as_const(f).target<large_func>(),
+              std::as_const(h).target<large_func>());
+
+    large_func* mine = g.target<large_func>();
+    EXPECT_EQ(2, large_func::instances());
+    EXPECT_NE(std::as_const(f).target<large_func>(), mine);
+    EXPECT_EQ(mine, g.target<large_func>());
+
+    function<int()> moved = std::move(f);
+    EXPECT_EQ(42, moved());
+  }
+  large_func::assert_no_instances();
+
+  function<int()> small(shared_storage, small_func(1));
+  function<int()> small_copy = small;
+  EXPECT_NE(small.target<small_func>(), small_copy.target<small_func>());
+}
+
+TEST(function_test, shared_storage_non_standard_layout) {
+  function<int()> f(shared_storage, polymorphic_func(7));
+  function<int()> g = f;
+  EXPECT_EQ(std::as_const(f).target<polymorphic_func>(),
+            std::as_const(g).target<polymorphic_func>());
+  g.target<polymorphic_func>()->value = 8;
+  EXPECT_EQ(7, f());
+  EXPECT_EQ(8, g());
+}
+
+template <typename F>
+using inline_function =
+    function_sbo<F, sizeof(void*), alignof(void*), /*InlineInvoke=*/true>;
+
+static_assert(sizeof(inline_function<void()>) == 3 * sizeof(void*));
+static_assert(sizeof(function<void()>) == 2 * sizeof(void*));
+
+TEST(function_test, inline_invoke) {
+  inline_function<int()> f = small_func(42);
+  inline_function<int()> g = large_func(43);
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(43, g());
+
+  f.swap(g);
+  EXPECT_EQ(43, f());
+  EXPECT_EQ(42, g());
+
+  inline_function<int()> h;
+  EXPECT_THROW(h(), bad_function_call);
+  h = f;
+  EXPECT_EQ(43, h());
+  h = std::move(g);
+  EXPECT_EQ(42, h());
+  EXPECT_NE(nullptr, h.target<small_func>());
+
+  unique_function<int()> u(copyable_storage, small_func(44));
+  inline_function<int()> from_unique(std::move(u));
+  EXPECT_EQ(44, from_unique());
+}
+
+static_assert(sizeof(function_ref<void()>) == 2 * sizeof(void*));
+static_assert(std::is_trivially_copyable_v<function_ref<int(int)>>);
+
+namespace {
+int apply(function_ref<int(int)> f, int x) {
+  return f(x);
+}
+
+int twice(int x) {
+  return 2 * x;
+}
+} // namespace
+
+TEST(function_ref_test, callables) {
+  int offset = 10;
+  auto lambda = [&offset](int x) { return x + offset; };
+  EXPECT_EQ(15, apply(lambda, 5));
+  EXPECT_EQ(6, apply([](int x) { return x + 1; }, 5));
+  EXPECT_EQ(10, apply(twice, 5));
+  EXPECT_EQ(10, apply(&twice, 5));
+
+  function<int(int)> f = lambda;
+  EXPECT_EQ(15, apply(f, 5));
+  EXPECT_EQ(42, apply(function<int(int)>([](int) { return 42; }), 5));
+}
+
+TEST(function_ref_test, refers_to_object) {
+  struct counter {
+    int operator()(int x) {
+      return value += x;
+    }
+    int value = 0;
+  } c;
+  function_ref<int(int)> r = c;
+  function_ref<int(int)> copy = r;
+  r(1);
+  copy(2);
+  EXPECT_EQ(3, c.value);
+}
+
+TEST(function_ref_test, arguments_ref) {
+  int x = 42;
+  function_ref<int&(int&)> f = [](int& a) -> int& { return a; };
+  EXPECT_EQ(&x, &f(x));
+
+  function_ref<non_copyable(non_copyable)> g = [](non_copyable a) {
+    return a;
+  };
+  g(non_copyable());
+}
+
+TEST(function_ref_test, discards_result) {
+  int calls = 0;
+  auto lambda = [&calls] { return ++calls; };
+  function_ref<void()> r = lambda;
+  r();
+  function_ref<void(int)> p = twice;
+  p(1);
+  EXPECT_EQ(1, calls);
+}
+
+struct message_a {};
+struct message_b {};
+
+TEST(multi_function_test, overloads) {
+  struct handler {
+    int operator()(message_a) const {
+      return 1;
+    }
+    int operator()(message_b) const {
+      return 2;
+    }
+    int operator()(int x) const {
+      return x;
+    }
+  };
+  multi_function<int(message_a), int(message_b), int(int)> f = handler();
+  EXPECT_EQ(1, f(message_a()));
+  EXPECT_EQ(2, f(message_b()));
+  EXPECT_EQ(42, f(42));
+  EXPECT_TRUE(f.target<handler>() != nullptr);
+  EXPECT_EQ(nullptr, f.target<small_func>());
+  static_assert(
+      !std::is_constructible_v<multi_function<int(message_a), int(int)>,
+                               small_func>);
+}
+
+TEST(multi_function_test, empty) {
+  multi_function<void(int), void(message_a)> f;
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_THROW(f(1), bad_function_call);
+  EXPECT_THROW(f(message_a()), bad_function_call);
+}
+
+TEST(multi_function_test, single_state) {
+  {
+    auto state = [f = large_func(42)](auto) { return f(); };
+    multi_function<int(message_a), int(message_b)> f = state;
+    EXPECT_EQ(2, large_func::instances());
+    multi_function<int(message_a), int(message_b)> g = f;
+    EXPECT_EQ(3, large_func::instances());
+    multi_function<int(message_a), int(message_b)> h = std::move(g);
+    EXPECT_EQ(3, large_func::instances());
+    g = h;
+    f.swap(g);
+    EXPECT_EQ(42, f(message_a()));
+    EXPECT_EQ(42, h(message_b()));
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(function_vector_test, invoke_all) {
+  function_vector<void(int&)> v;
+  EXPECT_TRUE(v.empty());
+  v.append([](int& x) { x += 1; });
+  v.append(+[](int& x) { x += 10; });
+  v.append([d = 100](int& x) { x += d; });
+  v.append([](int& x) { x += 1; });
+  EXPECT_EQ(4, v.size());
+  int x = 0;
+  v.invoke_all(x);
+  EXPECT_EQ(112, x);
+}
+
+TEST(function_vector_test, erase) {
+  function_vector<void(std::vector<int>&)> v;
+  using handle = function_vector<void(std::vector<int>&)>::handle;
+  std::vector<handle> handles;
+  for (int i = 0; i < 10; i++) {
+    handles.push_back(v.append([i](std::vector<int>& out) { out.push_back(i); }));
+  }
+  v.erase(handles[0]);
+  v.erase(handles[5]);
+  v.erase(handles[9]);
+  handle h = v.append([](std::vector<int>& out) { out.push_back(42); });
+  v.erase(handles[3]);
+  EXPECT_EQ(7, v.size());
+
+  std::vector<int> out;
+  v.invoke_all(out);
+  std::sort(out.begin(), out.end());
+  EXPECT_EQ((std::vector<int>{1, 2, 4, 6, 7, 8, 42}), out);
+
+  v.erase(h);
+  out.clear();
+  v.invoke_all(out);
+  EXPECT_EQ(6, out.size());
+}
+
+TEST(function_vector_test, no_leaks) {
+  {
+    function_vector<void(int)> v;
+    std::vector<function_vector<void(int)>::handle> handles;
+    for (int i = 0; i < 100; i++) {
+      handles.push_back(v.append([f = large_func(i)](int) { f(); }));
+      v.append([](int) {});
+    }
+    EXPECT_EQ(100, large_func::instances());
+    for (size_t i = 0; i < handles.size(); i += 2) {
+      v.erase(handles[i]);
+    }
+    EXPECT_EQ(50, large_func::instances());
+    function_vector<void(int)> moved = std::move(v);
+    moved.invoke_all(1);
+    v = std::move(moved);
+    EXPECT_EQ(50, large_func::instances());
+    v.clear();
+    EXPECT_EQ(0, large_func::instances());
+    v.append([f = large_func(1)](int) { f(); });
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(function_vector_test, over_aligned) {
+  struct alignas(64) aligned {
+    void operator()(bool& ok) const {
+      ok = ok && reinterpret_cast<std::uintptr_t>(this) % 64 == 0;
+    }
+  };
+  function_vector<void(bool&)> v;
+  for (int i = 0; i < 10; i++) {
+    v.append(aligned());
+  }
+  bool ok = true;
+  v.invoke_all(ok);
+  EXPECT_TRUE(ok);
+}
+
+TEST(work_stealing_deque_test, owner) {
+  work_stealing_deque<int> d(2);
+  for (int i = 0; i < 100; i++) {
+    d.push(i);
+  }
+  EXPECT_EQ(0, d.steal());
+  for (int i = 99; i > 0; i--) {
+    EXPECT_EQ(i, d.pop());
+  }
+  EXPECT_EQ(std::nullopt, d.pop());
+  EXPECT_EQ(std::nullopt, d.steal());
+  EXPECT_TRUE(d.empty());
+}
+
+TEST(work_stealing_deque_test, concurrent_steal) {
+  constexpr int n = 100000;
+  work_stealing_deque<int> d;
+  std::atomic<bool> done{false};
+  std::vector<int> taken(n, 0);
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 3; i++) {
+    thieves.emplace_back([&] {
+      std::vector<int> mine;
+      while (!done.load()) {
+        if (auto x = d.steal()) {
+          mine.push_back(*x);
+        }
+      }
+      for (int x : mine) {
+        std::atomic_ref(taken[x]).fetch_add(1);
+      }
+    });
+  }
+  for (int i = 0; i < n; i++) {
+    d.push(i);
+    if (i % 3 == 0) {
+      if (auto x = d.pop()) {
+        std::atomic_ref(taken[*x]).fetch_add(1);
+      }
+    }
+  }
+  while (auto x = d.pop()) {
+    std::atomic_ref(taken[*x]).fetch_add(1);
+  }
+  done.store(true);
+  for (auto& t : thieves) {
+    t.join();
+  }
+  EXPECT_EQ(std::vector<int>(n, 1), taken);
+}
+
+TEST(thread_pool_test, submit) {
+  thread_pool pool(4);
+  EXPECT_EQ(4, pool.size());
+  auto f = pool.submit([] { return 42; });
+  auto g = pool.submit([x = std::make_unique<int>(5)] { return *x; });
+  EXPECT_EQ(42, f.get());
+  EXPECT_EQ(5, g.get());
+  EXPECT_FALSE(f.valid());
+
+  auto e = pool.submit([]() -> int { throw std::runtime_error("task"); });
+  EXPECT_THROW(e.get(), std::runtime_error);
+}
+
+TEST(thread_pool_test, execute_all) {
+  std::atomic<int> count{0};
+  {
+    thread_pool pool(3);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; i++) {
+      producers.emplace_back([&] {
+        for (int j = 0; j < 10000; j++) {
+          pool.execute([&count] { count.fetch_add(1); });
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+  }
+  EXPECT_EQ(40000, count.load());
+}
+
+TEST(thread_pool_test, external_submit) {
+  thread_pool pool(4);
+  std::vector<std::thread> producers;
+  std::vector<long long> sums(4);
+  for (int i = 0; i < 4; i++) {
+    producers.emplace_back([&pool, &sums, i] {
+      std::vector<future<int>> results;
+      for (int j = 0; j < 2000; j++) {
+        results.push_back(pool.submit([j] { return j; }));
+      }
+      for (auto& r : results) {
+        sums[i] += r.get();
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  EXPECT_EQ(std::vector<long long>(4, 2000LL * 1999 / 2), sums);
+}
+
+TEST(thread_pool_test, submit_destroys_callable_before_result) {
+  thread_pool pool(2);
+  auto resource = std::make_shared<int>(1);
+  auto f = pool.submit([resource] { return *resource; });
+  EXPECT_EQ(1, f.get());
+  EXPECT_EQ(1, resource.use_count());
+}
+
+namespace {
+long long parallel_sum(thread_pool& pool, int from, int to) {
+  if (to - from <= 100) {
+    long long res = 0;
+    for (int i = from; i < to; i++) {
+      res += i;
+    }
+    return res;
+  }
+  int mid = from + (to - from) / 2;
+  auto left = pool.submit([&pool, from, mid] {
+    return parallel_sum(pool, from, mid);
+  });
+  long long right = parallel_sum(pool, mid, to);
+  return left.get() + right;
+}
+} // namespace
+
+TEST(thread_pool_test, nested) {
+  thread_pool pool(4);
+  auto res = pool.submit([&pool] { return parallel_sum(pool, 0, 100000); });
+  EXPECT_EQ(100000LL * 99999 / 2, res.get());
+
+  thread_pool single(1);
+  auto f = single.submit([&single] {
+    auto inner = single.submit([] {});
+    inner.get();
+    return 1;
+  });
+  EXPECT_EQ(1, f.get());
+}
+
+TEST(mpsc_queue_test, order) {
+  mpsc_queue<> q(4);
+  EXPECT_EQ(4, q.capacity());
+  EXPECT_TRUE(q.empty());
+  std::vector<int> out;
+  for (int i = 0; i < 3; i++) {
+    q.push([&out, i] { out.push_back(i); });
+  }
+  EXPECT_EQ(2, q.drain(2));
+  q.push([&out] { out.push_back(3); });
+  q.push([x = std::make_unique<int>(4), &out] { out.push_back(*x); });
+  EXPECT_EQ(3, q.drain());
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), out);
+  EXPECT_EQ(0, q.drain());
+}
+
+TEST(mpsc_queue_test, throwing_task) {
+  mpsc_queue<> q(2);
+  int count = 0;
+  q.push([] { throw std::runtime_error("task"); });
+  q.push([&count] { ++count; });
+  EXPECT_THROW(q.drain(), std::runtime_error);
+  EXPECT_EQ(1, q.drain());
+  EXPECT_EQ(1, count);
+}
+
+TEST(mpsc_queue_test, producers) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 20000;
+  mpsc_queue<> q(64);
+  std::vector<int> last(producers, -1);
+  bool ordered = true;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < per_producer; i++) {
+        q.push([&, p, i] {
+          ordered = ordered && last[p] == i - 1;
+          last[p] = i;
+        });
+      }
+    });
+  }
+  int done = 0;
+  while (done < producers * per_producer) {
+    q.wait();
+    done += q.drain(16);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(std::vector<int>(producers, per_producer - 1), last);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(timer_wheel_test, schedule_and_cancel) {
+  timer_wheel wheel;
+  std::vector<int> fired;
+  timer a, b, c;
+  wheel.schedule(a, 5, [&] { fired.push_back(1); });
+  wheel.schedule(b, 3, [&] { fired.push_back(2); });
+  wheel.schedule(c, 3, [&] { fired.push_back(3); });
+  EXPECT_EQ(3, wheel.size());
+  c.cancel();
+  EXPECT_FALSE(c.scheduled());
+  EXPECT_EQ(0, wheel.advance(2));
+  EXPECT_EQ(1, wheel.advance());
+  EXPECT_EQ(std::vector<int>{2}, fired);
+  {
+    timer d;
+    wheel.schedule(d, 1, [&] { fired.push_back(4); });
+  }
+  EXPECT_EQ(1, wheel.advance(10));
+  EXPECT_EQ((std::vector<int>{2, 1}), fired);
+  EXPECT_EQ(0, wheel.size());
+  EXPECT_EQ(13, wheel.now());
+}
+
+TEST(timer_wheel_test, reschedule_from_callback) {
+  timer_wheel wheel;
+  timer t;
+  int count = 0;
+  wheel.schedule(t, 100, [&] {
+    if (++count < 5) {
+      wheel.schedule(t, 100);
+    }
+  });
+  EXPECT_EQ(5, wheel.advance(1000));
+  EXPECT_EQ(5, count);
+  EXPECT_FALSE(t.scheduled());
+}
+
+TEST(timer_wheel_test, throwing_callback) {
+  timer_wheel wheel;
+  timer a, b;
+  int count = 0;
+  wheel.schedule(a, 2, [] { throw std::runtime_error("timer"); });
+  wheel.schedule(b, 2, [&] { ++count; });
+  EXPECT_THROW(wheel.advance(5), std::runtime_error);
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(1, wheel.advance(0));
+  EXPECT_EQ(1, count);
+}
+
+TEST(timer_wheel_test, compare_to_map) {
+  std::mt19937_64 e(42);
+  timer_wheel wheel;
+  std::vector<timer> timers(2000);
+  std::multimap<std::uint64_t, std::size_t> expected;
+  std::vector<std::pair<std::uint64_t, std::size_t>> fired;
+  auto delay = [&] {
+    // все уровни колеса и срок за его пределами
+    switch (e() % 5) {
+    case 0: return e() % 300;
+    case 1: return e() % 70000;
+    case 2: return e() % 20000000;
+    case 3: return e() % (std::uint64_t(1) << 33);
+    default: return std::uint64_t(1) << 40;
+    }
+  };
+  for (std::size_t i = 0; i < timers.size(); i++) {
+    std::uint64_t d = delay();
+    wheel.schedule(timers[i], d, [&, i] { fired.emplace_back(wheel.now(), i); });
+    expected.emplace(std::max<std::uint64_t>(d, 1), i);
+  }
+  for (std::size_t i = 0; i < timers.size(); i += 3) {
+    timers[i].cancel();
+  }
+  std::erase_if(expected, [](auto const& p) { return p.second % 3 == 0; });
+
+  std::uint64_t step = 1;
+  while (wheel.size() != 0) {
+    wheel.advance(step);
+    step = step * 2 + e() % 7;
+  }
+  ASSERT_EQ(expected.size(), fired.size());
+  for (auto [when, i] : fired) {
+    EXPECT_EQ(timers[i].expires(), when);
+    EXPECT_EQ(1, std::erase_if(expected, [&](auto const& p) {
+                return p.second == i && p.first == when;
+              }));
+  }
+}
+
+TEST(atomic_function_test, store) {
+  atomic_function<int(int)> f;
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_THROW(f(1), bad_function_call);
+  f.store([](int x) { return x + 1; });
+  EXPECT_EQ(2, f(1));
+  f.store([](int x) { return x * 10; });
+  EXPECT_EQ(10, f(1));
+  EXPECT_EQ(20, f.load()(2));
+  f.store({});
+  EXPECT_THROW(f(1), bad_function_call);
+  epoch::synchronize();
+  EXPECT_EQ(0, epoch::pending());
+}
+
+namespace {
+struct tracked {
+  explicit tracked(int v) : value(v) {
+    ++alive;
+  }
+  tracked(tracked const& other) : value(other.value) {
+    ++alive;
+  }
+  ~tracked() {
+    value = -1;
+    --alive;
+  }
+  int operator()() const {
+    return value;
+  }
+
+  int value;
+  std::array<char, 64> payload{};
+  static inline std::atomic<int> alive{0};
+};
+} // namespace
+
+TEST(atomic_function_test, concurrent_store) {
+  {
+    atomic_function<int()> f(tracked(0));
+    std::atomic<bool> done{false};
+    std::atomic<bool> broken{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; i++) {
+      readers.emplace_back([&] {
+        int last = 0;
+        while (!done.load()) {
+          int v = f();
+          // версии только растут, удаленный объект дал бы -1
+          if (v < last) {
+            broken.store(true);
+          }
+          last = v;
+        }
+      });
+    }
+    for (int i = 1; i <= 2000; i++) {
+      f.store(tracked(i));
+    }
+    done.store(true);
+    for (auto& t : readers) {
+      t.join();
+    }
+    EXPECT_FALSE(broken.load());
+    EXPECT_EQ(2000, f());
+  }
+  epoch::synchronize();
+  EXPECT_EQ(0, tracked::alive.load());
+}
+
+TEST(memoized_function_test, hits) {
+  int calls = 0;
+  memoized_function<int(int, int)> f([&](int a, int b) {
+    ++calls;
+    return a * b;
+  }, 64);
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 10; i++) {
+      EXPECT_EQ(i * 7, f(i, 7));
+    }
+  }
+  EXPECT_EQ(10, calls);
+  memo::stats s = f.stats();
+  EXPECT_EQ(20, s.hits);
+  EXPECT_EQ(10, s.misses);
+  EXPECT_EQ(0, s.evictions);
+  EXPECT_DOUBLE_EQ(2.0 / 3, s.hit_rate());
+}
+
+TEST(memoized_function_test, string_key) {
+  memoized_function<std::size_t(std::string const&)> f(
+      [](std::string const& s) { return s.size(); }, 16);
+  EXPECT_EQ(5, f("hello"));
+  EXPECT_EQ(5, f(std::string("hello")));
+  EXPECT_EQ(0, f(""));
+  EXPECT_EQ(1, f.stats().hits);
+}
+
+TEST(memoized_function_test, bounded) {
+  memoized_function<int(int), memo::random> f([](int x) { return -x; }, 100);
+  EXPECT_EQ(100, f.capacity());
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(-i, f(i));
+    EXPECT_LE(f.size(), 100);
+  }
+  EXPECT_EQ(100, f.size());
+  memo::stats s = f.stats();
+  EXPECT_EQ(10000, s.misses);
+  EXPECT_EQ(10000 - 100, s.evictions);
+}
+
+TEST(memoized_function_test, bounded_sharded) {
+  // 10 записей на 16 шардов: у части шардов емкость 0
+  memoized_function<int(int), memo::lru, true> f([](int x) { return x; }, 10);
+  EXPECT_EQ(10, f.capacity());
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(i, f(i));
+  }
+  EXPECT_LE(f.size(), 10);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(i, f(i));
+  }
+  EXPECT_LE(f.size(), 10);
+  EXPECT_EQ(2000, f.stats().misses + f.stats().hits);
+}
+
+TEST(memoized_function_test, eviction_policy) {
+  int calls = 0;
+  auto id = [&](int x) {
+    ++calls;
+    return x;
+  };
+  // емкость 8 -- одна группа ячеек. Ключ 0 используется часто, но давно,
+  // 1..7 -- недавно по разу, 8 вытесняет одного из них
+  auto fill = [](auto& f) {
+    for (int i = 0; i < 5; i++) {
+      f(0);
+    }
+    for (int i = 1; i <= 8; i++) {
+      f(i);
+    }
+  };
+
+  memoized_function<int(int), memo::lru> lru(id, 8);
+  fill(lru);
+  calls = 0;
+  lru(0);
+  EXPECT_EQ(1, calls);
+
+  memoized_function<int(int), memo::lfu> lfu(id, 8);
+  fill(lfu);
+  calls = 0;
+  lfu(0);
+  EXPECT_EQ(0, calls);
+}
+
+TEST(memoized_function_test, concurrent) {
+  std::atomic<int> calls{0};
+  memoized_function<long(int), memo::lru, true> f(
+      [&](int x) {
+        calls.fetch_add(1);
+        return static_cast<long>(x) * x;
+      },
+      1024, 8);
+  std::atomic<bool> broken{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 200; i++) {
+          if (f(i) != static_cast<long>(i) * i) {
+            broken.store(true);
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(broken.load());
+  memo::stats s = f.stats();
+  EXPECT_EQ(4 * 50 * 200, s.hits + s.misses);
+  EXPECT_EQ(calls.load(), s.misses);
+  // повторные вычисления возможны только при первом обращении к ключу
+  EXPECT_LE(calls.load(), 4 * 200);
+}
+
+namespace {
+struct profiled {
+  int operator()(int x) const {
+    return x + 1;
+  }
+};
+} // namespace
+
+TEST(profiling_test, counts_calls) {
+  profiling::reset();
+  function<int(int)> f = profiled{};
+  function<int()> g = large_func(1);
+  for (int i = 0; i < 10; i++) {
+    f(i);
+  }
+  g();
+  auto records = profiling::snapshot();
+  auto find = [&](std::string_view name) {
+    return std::find_if(records.begin(), records.end(), [&](auto const& r) {
+      return r.name.find(name) != std::string::npos;
+    });
+  };
+#ifdef FUNCTION_PROFILING
+  ASSERT_NE(records.end(), find("profiled"));
+  EXPECT_EQ(10, find("profiled")->calls);
+  ASSERT_NE(records.end(), find("large_func"));
+  EXPECT_EQ(1, find("large_func")->calls);
+#else
+  EXPECT_EQ(records.end(), find("profiled"));
+#endif
 }
 
 int main(int argc, char* argv[]) {
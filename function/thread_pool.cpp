@@ -0,0 +1,239 @@
+#include "thread_pool.h"
+
+namespace {
+struct current_worker {
+  thread_pool* pool = nullptr;
+  std::size_t index = 0;
+};
+
+thread_local current_worker current;
+
+std::uint64_t next_random(std::uint64_t& seed) noexcept {
+  // xorshift64
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+// Задача execute
+struct posted final : pool_details::task_node {
+  explicit posted(thread_pool::task fn) : fn(std::move(fn)) {
+    call = [](task_node* self) noexcept {
+      std::unique_ptr<posted> owner(static_cast<posted*>(self));
+      owner->fn();
+    };
+  }
+
+  thread_pool::task fn;
+};
+
+// Сколько задач рабочий забирает из общей очереди за раз: первую выполняет,
+// остальные кладет в свой дек
+constexpr std::size_t injection_batch = 32;
+} // namespace
+
+pool_details::injection_queue::injection_queue() noexcept
+    : head(&stub), tail(&stub) {}
+
+void pool_details::injection_queue::push(task_node* node) noexcept {
+  node->next.store(nullptr, std::memory_order_relaxed);
+  task_node* prev = head.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+}
+
+bool pool_details::injection_queue::empty() const noexcept {
+  // stub возвращается в очередь, только когда забран последний узел.
+  // seq_cst -- в паре с fence в thread_pool::wake для засыпающего рабочего
+  return head.load() == &stub;
+}
+
+bool pool_details::injection_queue::try_acquire() noexcept {
+  return !busy.load(std::memory_order_relaxed) &&
+         !busy.exchange(true, std::memory_order_acquire);
+}
+
+void pool_details::injection_queue::release() noexcept {
+  busy.store(false, std::memory_order_release);
+}
+
+pool_details::task_node* pool_details::injection_queue::pop() noexcept {
+  task_node* first = tail;
+  task_node* next = first->next.load(std::memory_order_acquire);
+  if (first == &stub) {
+    if (!next) {
+      return nullptr;
+    }
+    tail = first = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next) {
+    tail = next;
+    return first;
+  }
+  if (first != head.load(std::memory_order_acquire)) {
+    // производитель между exchange и записью next
+    return nullptr;
+  }
+  // first -- последний: stub ставится за ним, чтобы его можно было забрать
+  push(&stub);
+  next = first->next.load(std::memory_order_acquire);
+  if (next) {
+    tail = next;
+    return first;
+  }
+  return nullptr;
+}
+
+thread_pool::thread_pool(std::size_t count) {
+  count = std::max<std::size_t>(count, 1);
+  workers.reserve(count);
+  for (std::size_t i = 0; i < count; i++) {
+    workers.push_back(std::make_unique<worker>());
+    workers.back()->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+  }
+  try {
+    for (std::size_t i = 0; i < count; i++) {
+      workers[i]->thread = std::thread([this, i] { worker_loop(i); });
+    }
+  } catch (...) {
+    stopping.store(true);
+    epoch.fetch_add(1);
+    epoch.notify_all();
+    for (auto& w : workers) {
+      if (w->thread.joinable()) {
+        w->thread.join();
+      }
+    }
+    throw;
+  }
+}
+
+thread_pool::~thread_pool() {
+  stopping.store(true);
+  epoch.fetch_add(1);
+  epoch.notify_all();
+  for (auto& w : workers) {
+    w->thread.join();
+  }
+}
+
+void thread_pool::execute(task t) {
+  enqueue(new posted(std::move(t)));
+}
+
+void thread_pool::enqueue(task_node* node) noexcept {
+  if (current.pool == this) {
+    try {
+      workers[current.index]->deque.push(node);
+    } catch (...) {
+      // не удалось расширить дек
+      injection.push(node);
+    }
+  } else {
+    injection.push(node);
+  }
+  wake();
+}
+
+void thread_pool::wake() {
+  // парная к увеличению sleepers: либо рабочий увидит задачу при повторной
+  // проверке, либо мы увидим его и разбудим
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers.load(std::memory_order_relaxed) > 0) {
+    epoch.fetch_add(1);
+    epoch.notify_one();
+  }
+}
+
+void thread_pool::run(task_node* node) noexcept {
+  node->call(node);
+}
+
+thread_pool::task_node* thread_pool::take_injected(worker& me) {
+  if (injection.empty() || !injection.try_acquire()) {
+    return nullptr;
+  }
+  task_node* res = injection.pop();
+  std::size_t moved = 0;
+  while (res && moved + 1 < injection_batch) {
+    task_node* node = injection.pop();
+    if (!node) {
+      break;
+    }
+    try {
+      me.deque.push(node);
+    } catch (...) {
+      injection.push(node);
+      break;
+    }
+    moved++;
+  }
+  injection.release();
+  if (moved != 0) {
+    // разбудившие нас производители могли разбудить и других, которые
+    // застали очередь занятой и снова уснули
+    wake();
+  }
+  return res;
+}
+
+thread_pool::task_node* thread_pool::find_work(std::size_t self) {
+  worker& me = *workers[self];
+  if (auto t = me.deque.pop()) {
+    return *t;
+  }
+  if (task_node* t = take_injected(me)) {
+    return t;
+  }
+  // один проход по остальным, начиная со случайного
+  std::size_t n = workers.size();
+  std::size_t start = next_random(me.seed) % n;
+  for (std::size_t i = 0; i < n; i++) {
+    std::size_t victim = (start + i) % n;
+    if (victim == self) {
+      continue;
+    }
+    if (auto t = workers[victim]->deque.steal()) {
+      return *t;
+    }
+  }
+  return nullptr;
+}
+
+void thread_pool::worker_loop(std::size_t self) {
+  current = {this, self};
+  while (true) {
+    if (task_node* t = find_work(self)) {
+      run(t);
+      continue;
+    }
+    sleepers.fetch_add(1);
+    std::uint64_t e = epoch.load();
+    task_node* t = find_work(self);
+    if (!t) {
+      if (stopping.load()) {
+        sleepers.fetch_sub(1);
+        break;
+      }
+      epoch.wait(e);
+    }
+    sleepers.fetch_sub(1);
+    if (t) {
+      run(t);
+    }
+  }
+  current = {};
+}
+
+bool pool_details::run_pending_task() {
+  if (!current.pool) {
+    return false;
+  }
+  thread_pool::task_node* t = current.pool->find_work(current.index);
+  if (!t) {
+    return false;
+  }
+  thread_pool::run(t);
+  return true;
+}
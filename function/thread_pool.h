@@ -0,0 +1,256 @@
+#pragma once
+
+#include "function.h"
+#include "work_stealing_deque.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pool_details {
+// Выполняет одну задачу из пула, если текущий поток -- его рабочий.
+// Используется future::get, чтобы ожидающий рабочий не простаивал
+bool run_pending_task();
+
+// Узел задачи: деки рабочих и очередь внешних задач хранят указатели на
+// узлы, поэтому постановка ничего не аллоцирует сверх самого узла.
+// call выполняет задачу и освобождает узел
+struct task_node {
+  std::atomic<task_node*> next{nullptr};
+  void (*call)(task_node* self) noexcept = nullptr;
+};
+
+// Очередь задач, поставленных не из рабочих (интрузивная очередь Вьюкова):
+// push -- один exchange, без блокировок. Разбирает один рабочий за раз,
+// остальные в это время ее пропускают. Производитель, прерванный внутри
+// push, задерживает свою и следующие задачи, пока не продолжится.
+struct injection_queue {
+  injection_queue() noexcept;
+
+  injection_queue(injection_queue const&) = delete;
+  injection_queue& operator=(injection_queue const&) = delete;
+
+  // Любой поток
+  void push(task_node* node) noexcept;
+
+  // Любой поток. Может ошибиться только в сторону непустой
+  bool empty() const noexcept;
+
+  // Право разбирать очередь, false -- его держит другой поток
+  bool try_acquire() noexcept;
+  void release() noexcept;
+
+  // Только получивший право разбирать. nullptr, если очередь пуста или
+  // производитель еще не связал свой узел
+  task_node* pop() noexcept;
+
+private:
+  alignas(64) std::atomic<task_node*> head;
+  alignas(64) std::atomic<bool> busy{false};
+  task_node* tail;
+  task_node stub;
+};
+
+template <typename R>
+struct future_state {
+  using value_t = std::conditional_t<std::is_void_v<R>, char, R>;
+
+  virtual ~future_state() = default;
+
+  template <typename F>
+  void compute(F& f) noexcept {
+    try {
+      if constexpr (std::is_void_v<R>) {
+        std::invoke(f);
+        value.emplace();
+      } else {
+        value.emplace(std::invoke(f));
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+
+  void publish() noexcept {
+    ready.store(true, std::memory_order_release);
+    ready.notify_all();
+  }
+
+  void release() noexcept {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // future и задача
+  std::atomic<int> refs{2};
+  std::atomic<bool> ready{false};
+  std::optional<value_t> value;
+  std::exception_ptr error;
+};
+
+// Задача submit и состояние future в одной аллокации. f уничтожается сразу
+// после вызова, до того как результат станет доступен future
+template <typename R, typename F>
+struct submitted final : task_node, future_state<R> {
+  explicit submitted(F fn) {
+    new (&f) F(std::move(fn));
+    call = [](task_node* self) noexcept {
+      auto* s = static_cast<submitted*>(self);
+      s->compute(s->f);
+      s->f.~F();
+      s->publish();
+      s->release();
+    };
+  }
+
+  ~submitted() override {}
+
+  union {
+    F f;
+  };
+};
+} // namespace pool_details
+
+// Результат submit: один указатель на состояние, только перемещается.
+// get() можно вызвать один раз
+template <typename R>
+struct future {
+  future() = default;
+
+  future(future&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+
+  future& operator=(future&& other) noexcept {
+    if (this != &other) {
+      reset();
+      state = std::exchange(other.state, nullptr);
+    }
+    return *this;
+  }
+
+  ~future() {
+    reset();
+  }
+
+  bool valid() const noexcept {
+    return state != nullptr;
+  }
+
+  bool ready() const noexcept {
+    return state->ready.load(std::memory_order_acquire);
+  }
+
+  // Рабочий пула, пока ждет, выполняет другие задачи
+  void wait() const {
+    while (!ready()) {
+      if (!pool_details::run_pending_task()) {
+        state->ready.wait(false, std::memory_order_acquire);
+      }
+    }
+  }
+
+  R get() {
+    wait();
+    std::unique_ptr<pool_details::future_state<R>, deleter> s(
+        std::exchange(state, nullptr));
+    if (s->error) {
+      std::rethrow_exception(s->error);
+    }
+    if constexpr (!std::is_void_v<R>) {
+      return std::move(*s->value);
+    }
+  }
+
+private:
+  friend struct thread_pool;
+
+  struct deleter {
+    void operator()(pool_details::future_state<R>* s) const noexcept {
+      s->release();
+    }
+  };
+
+  explicit future(pool_details::future_state<R>* state) : state(state) {}
+
+  void reset() noexcept {
+    if (state) {
+      std::exchange(state, nullptr)->release();
+    }
+  }
+
+  pool_details::future_state<R>* state = nullptr;
+};
+
+// Пул потоков с перехватом работы: у каждого рабочего свой дек Chase-Lev,
+// задачи, поставленные из рабочего, идут в его дек, из других потоков -- в
+// общую очередь без блокировок (pool_details::injection_queue). Свободный
+// рабочий забирает задачи из своего дека, затем пачку из общей очереди (в
+// свой дек, откуда их крадут остальные), затем крадет у других.
+// Одна аллокация на задачу: execute -- узел с unique_function с буфером на
+// несколько слов, submit -- узел вместе с состоянием future.
+struct thread_pool {
+  using task = unique_function<void(), 6 * sizeof(void*)>;
+
+  explicit thread_pool(
+      std::size_t workers = std::max(1u, std::thread::hardware_concurrency()));
+
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+  // Дожидается выполнения всех поставленных задач
+  ~thread_pool();
+
+  // Исключение из задачи завершает программу (как у std::thread)
+  void execute(task t);
+
+  // Исключение из f передается в future::get
+  template <typename F>
+  future<std::invoke_result_t<F&>> submit(F f) {
+    using R = std::invoke_result_t<F&>;
+    auto* node = new pool_details::submitted<R, F>(std::move(f));
+    future<R> res(node);
+    enqueue(node);
+    return res;
+  }
+
+  std::size_t size() const noexcept {
+    return workers.size();
+  }
+
+private:
+  friend bool pool_details::run_pending_task();
+
+  using task_node = pool_details::task_node;
+
+  struct worker {
+    work_stealing_deque<task_node*> deque;
+    std::thread thread;
+    std::uint64_t seed;
+  };
+
+  void enqueue(task_node* node) noexcept;
+  void worker_loop(std::size_t self);
+  task_node* find_work(std::size_t self);
+  task_node* take_injected(worker& me);
+  void wake();
+  static void run(task_node* node) noexcept;
+
+  std::vector<std::unique_ptr<worker>> workers;
+  pool_details::injection_queue injection;
+
+  // Засыпающий рабочий ждет изменения epoch, пока sleepers > 0 постановка
+  // задачи увеличивает epoch и будит одного
+  std::atomic<std::uint64_t> epoch{0};
+  std::atomic<std::size_t> sleepers{0};
+  std::atomic<bool> stopping{false};
+};
@@ -0,0 +1,96 @@
+#include "timer_wheel.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+// 1M одновременно поставленных таймеров: timer_wheel против очереди с
+// приоритетами из function. Сроки случайные, до 2^20 тиков.
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+double ns_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+constexpr std::size_t timers = 1'000'000;
+constexpr std::uint64_t horizon = 1 << 20;
+
+std::vector<std::uint64_t> make_delays() {
+  std::mt19937_64 e(1);
+  std::vector<std::uint64_t> res(timers);
+  for (auto& d : res) {
+    d = 1 + e() % horizon;
+  }
+  return res;
+}
+
+void run_wheel(std::vector<std::uint64_t> const& delays) {
+  timer_wheel wheel;
+  auto owned = std::make_unique<timer[]>(timers);
+  std::size_t fired = 0;
+
+  auto start = clock_type::now();
+  for (std::size_t i = 0; i < timers; i++) {
+    wheel.schedule(owned[i], delays[i], [&fired] { ++fired; });
+  }
+  double schedule = ns_since(start) / timers;
+
+  start = clock_type::now();
+  for (std::size_t i = 0; i < timers; i += 2) {
+    owned[i].cancel();
+  }
+  double cancel = ns_since(start) / (timers / 2);
+
+  start = clock_type::now();
+  wheel.advance(horizon);
+  double expire = ns_since(start) / fired;
+
+  std::printf("%-24s %12.1f %12.1f %12.1f\n", "timer_wheel", schedule, cancel,
+              expire);
+}
+
+void run_queue(std::vector<std::uint64_t> const& delays) {
+  struct entry {
+    std::uint64_t expires;
+    function<void()> callback;
+
+    bool operator<(entry const& other) const {
+      return expires > other.expires;
+    }
+  };
+  std::priority_queue<entry> queue;
+  std::size_t fired = 0;
+
+  auto start = clock_type::now();
+  for (std::size_t i = 0; i < timers; i++) {
+    queue.push({delays[i], [&fired] { ++fired; }});
+  }
+  double schedule = ns_since(start) / timers;
+
+  start = clock_type::now();
+  for (std::uint64_t now = 0; !queue.empty(); now++) {
+    while (!queue.empty() && queue.top().expires <= now) {
+      queue.top().callback();
+      queue.pop();
+    }
+  }
+  double expire = ns_since(start) / fired;
+
+  std::printf("%-24s %12.1f %12s %12.1f\n", "priority_queue<function>",
+              schedule, "-", expire);
+}
+} // namespace
+
+int main() {
+  auto delays = make_delays();
+  std::printf("%-24s %12s %12s %12s\n", "1M timers, ns/op", "schedule",
+              "cancel", "expire");
+  run_wheel(delays);
+  run_queue(delays);
+}
@@ -0,0 +1,158 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+timer::~timer() {
+  cancel();
+}
+
+void timer::cancel() noexcept {
+  if (wheel) {
+    wheel->release(*this);
+  }
+}
+
+timer_wheel::~timer_wheel() {
+  auto detach = [](slot_t& slot) {
+    while (!slot.empty()) {
+      slot.front().wheel = nullptr;
+      slot.pop_front();
+    }
+  };
+  for (auto& level : wheels) {
+    for (auto& slot : level) {
+      detach(slot);
+    }
+  }
+  detach(due);
+}
+
+void timer_wheel::release(timer& t) noexcept {
+  t.unlink();
+  t.wheel = nullptr;
+  --active;
+  std::size_t level = t.slot / slots;
+  std::size_t index = t.slot % slots;
+  if (wheels[level][index].empty()) {
+    occupied[level][index / 64] &= ~(std::uint64_t(1) << (index % 64));
+  }
+}
+
+void timer_wheel::schedule(timer& t, std::uint64_t delay,
+                           function<void()> callback) {
+  t.callback = std::move(callback);
+  schedule(t, delay);
+}
+
+void timer_wheel::schedule(timer& t, std::uint64_t delay) {
+  t.cancel();
+  delay = std::max<std::uint64_t>(delay, 1);
+  std::uint64_t max = std::numeric_limits<std::uint64_t>::max() - current;
+  t.expires_at = current + std::min(delay, max);
+  t.wheel = this;
+  ++active;
+  place(t);
+}
+
+void timer_wheel::place(timer& t) {
+  std::uint64_t diff = t.expires_at - current;
+  // срок дальше верхнего уровня -- в последний слот достижимого диапазона,
+  // оттуда таймер снова будет разложен при спуске
+  std::uint64_t expires = t.expires_at;
+  constexpr std::uint64_t range = std::uint64_t(1) << (level_bits * levels);
+  if (diff >= range) {
+    expires = current + range - 1;
+    diff = range - 1;
+  }
+  std::size_t level = 0;
+  while (diff >= (std::uint64_t(1) << (level_bits * (level + 1)))) {
+    ++level;
+  }
+  std::size_t index = (expires >> (level_bits * level)) & slot_mask;
+  wheels[level][index].push_back(t);
+  occupied[level][index / 64] |= std::uint64_t(1) << (index % 64);
+  t.slot = static_cast<std::uint16_t>(level * slots + index);
+}
+
+// Вызывающий сразу переносит все таймеры слота, поэтому слот свободен
+timer_wheel::slot_t& timer_wheel::take_slot(std::size_t level,
+                                            std::size_t index) noexcept {
+  occupied[level][index / 64] &= ~(std::uint64_t(1) << (index % 64));
+  return wheels[level][index];
+}
+
+void timer_wheel::cascade(std::size_t level) {
+  slot_t& slot =
+      take_slot(level, (current >> (level_bits * level)) & slot_mask);
+  slot_t moving;
+  moving.splice(moving.end(), slot, slot.begin(), slot.end());
+  while (!moving.empty()) {
+    timer& t = moving.front();
+    moving.pop_front();
+    place(t);
+  }
+}
+
+std::size_t timer_wheel::fire_due() {
+  std::size_t fired = 0;
+  while (!due.empty()) {
+    timer& t = due.front();
+    release(t);
+    ++fired;
+    t.callback();
+  }
+  return fired;
+}
+
+std::uint64_t timer_wheel::next_event() const noexcept {
+  std::uint64_t res = std::numeric_limits<std::uint64_t>::max();
+  for (std::size_t level = 0; level < levels; level++) {
+    std::size_t shift = level_bits * level;
+    std::size_t index = (current >> shift) & slot_mask;
+    // первый занятый слот после текущего по кругу
+    for (std::size_t step = 1; step <= slots; step += 64) {
+      std::size_t from = (index + step) & slot_mask;
+      std::uint64_t bits = occupied[level][from / 64] >> (from % 64);
+      if (from % 64 != 0) {
+        bits |= occupied[level][(from / 64 + 1) % (slots / 64)]
+                << (64 - from % 64);
+      }
+      if (bits != 0) {
+        std::uint64_t distance = step + std::countr_zero(bits);
+        if (distance <= slots) {
+          // тик, на котором этот слот спускается (для уровня 0 --
+          // вызывается)
+          res = std::min(res, ((current >> shift) + distance) << shift);
+        }
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+std::size_t timer_wheel::advance(std::uint64_t ticks) {
+  std::size_t fired = fire_due();
+  while (ticks > 0) {
+    std::uint64_t next = next_event();
+    if (next - current > ticks) {
+      current += ticks;
+      break;
+    }
+    // пропущенные тики не вызывают и не спускают ничего
+    ticks -= next - current;
+    current = next;
+    // младшие уровни сделали оборот -- спускаем, начиная со старшего
+    for (std::size_t level = levels - 1; level > 0; level--) {
+      if ((current & ((std::uint64_t(1) << (level_bits * level)) - 1)) == 0) {
+        cascade(level);
+      }
+    }
+    slot_t& slot = take_slot(0, current & slot_mask);
+    due.splice(due.end(), slot, slot.begin(), slot.end());
+    fired += fire_due();
+  }
+  return fired;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../intrusive-list/intrusive_list.h"
+#include "function.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct timer_wheel;
+struct timer_wheel_tag;
+
+// Таймер принадлежит пользователю и сам служит дескриптором отмены:
+// cancel() и деструктор за O(1) вынимают его из колеса. Обратный вызов
+// хранится в таймере и вызывается на месте, поэтому таймер должен пережить
+// свой вызов; из обратного вызова его можно перезапустить или отменить.
+struct timer : intrusive::list_element<timer_wheel_tag> {
+  timer() = default;
+
+  timer(timer const&) = delete;
+  timer& operator=(timer const&) = delete;
+
+  ~timer();
+
+  void cancel() noexcept;
+
+  bool scheduled() const noexcept {
+    return wheel != nullptr;
+  }
+
+  std::uint64_t expires() const noexcept {
+    return expires_at;
+  }
+
+private:
+  friend struct timer_wheel;
+
+  function<void()> callback;
+  std::uint64_t expires_at = 0;
+  timer_wheel* wheel = nullptr;
+  // уровень * 256 + слот, в котором лежит таймер
+  std::uint16_t slot = 0;
+};
+
+// Иерархическое колесо таймеров: 4 уровня по 256 слотов, время в тиках.
+// Таймер кладется в слот уровня, соответствующего старшему отличающемуся
+// байту срока, и спускается на уровень ниже, когда младший уровень делает
+// оборот. Постановка и отмена -- O(1), срабатывание -- O(1) на таймер.
+// Занятые слоты отмечены в битовых масках уровней, поэтому advance
+// перескакивает пустые промежутки, не перебирая тики.
+struct timer_wheel {
+  timer_wheel() = default;
+
+  timer_wheel(timer_wheel const&) = delete;
+  timer_wheel& operator=(timer_wheel const&) = delete;
+
+  ~timer_wheel();
+
+  // Сработает через delay тиков (не меньше одного). Уже поставленный таймер
+  // переставляется
+  void schedule(timer& t, std::uint64_t delay, function<void()> callback);
+
+  // Переставляет таймер, сохраняя его обратный вызов
+  void schedule(timer& t, std::uint64_t delay);
+
+  // Продвигает время на ticks тиков, вызывая истекшие таймеры, возвращает
+  // число вызовов. Если обратный вызов бросил, исключение выходит наружу, а
+  // остальные истекшие таймеры будут вызваны следующим advance
+  std::size_t advance(std::uint64_t ticks = 1);
+
+  std::uint64_t now() const noexcept {
+    return current;
+  }
+
+  std::size_t size() const noexcept {
+    return active;
+  }
+
+private:
+  friend struct timer;
+
+  static constexpr std::size_t levels = 4;
+  static constexpr std::size_t level_bits = 8;
+  static constexpr std::size_t slots = std::size_t(1) << level_bits;
+  static constexpr std::uint64_t slot_mask = slots - 1;
+
+  using slot_t = intrusive::list<timer, timer_wheel_tag>;
+  using bitmap_t = std::array<std::uint64_t, slots / 64>;
+
+  void place(timer& t);
+  slot_t& take_slot(std::size_t level, std::size_t index) noexcept;
+  void cascade(std::size_t level);
+  std::size_t fire_due();
+  void release(timer& t) noexcept;
+  // ближайший тик после current, на котором есть что спускать или вызывать
+  std::uint64_t next_event() const noexcept;
+
+  std::array<std::array<slot_t, slots>, levels> wheels;
+  std::array<bitmap_t, levels> occupied{};
+  // истекшие на текущем тике, еще не вызванные
+  slot_t due;
+  std::uint64_t current = 0;
+  std::size_t active = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Дек Chase-Lev (в варианте Le, Pop, Cohen, Nardelli для модели памяти C11):
+// владелец кладет и забирает с нижнего конца, остальные потоки крадут с
+// верхнего. push/pop владельца без CAS, кроме борьбы за последний элемент.
+// Вор читает ячейку до CAS и при неудаче выбрасывает прочитанное, поэтому
+// T должен тривиально копироваться (обычно это указатель).
+template <typename T>
+struct work_stealing_deque {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  explicit work_stealing_deque(std::size_t capacity = 64) {
+    retired.push_back(std::make_unique<ring>(round_up(capacity)));
+    buffer.store(retired.back().get(), std::memory_order_relaxed);
+  }
+
+  work_stealing_deque(work_stealing_deque const&) = delete;
+  work_stealing_deque& operator=(work_stealing_deque const&) = delete;
+
+  // Только владелец
+  void push(T value) {
+    std::int64_t b = bottom.load(std::memory_order_relaxed);
+    std::int64_t t = top.load(std::memory_order_acquire);
+    ring* r = buffer.load(std::memory_order_relaxed);
+    if (b - t > static_cast<std::int64_t>(r->mask)) {
+      r = grow(r, t, b);
+    }
+    r->put(b, value);
+    // release-запись вместо барьера: то же упорядочение, и его видит TSan
+    bottom.store(b + 1, std::memory_order_release);
+  }
+
+  // Только владелец
+  std::optional<T> pop() {
+    std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    ring* r = buffer.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    std::optional<T> res = r->get(b);
+    if (t == b) {
+      // последний элемент -- соревнуемся с ворами
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        res.reset();
+      }
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return res;
+  }
+
+  // Любой поток
+  std::optional<T> steal() {
+    std::int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return std::nullopt;
+    }
+    ring* r = buffer.load(std::memory_order_acquire);
+    T res = r->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return res;
+  }
+
+  // Приблизительно, если дек одновременно меняется
+  bool empty() const noexcept {
+    return bottom.load(std::memory_order_relaxed) <=
+           top.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct ring {
+    explicit ring(std::size_t capacity)
+        : mask(capacity - 1), cells(new std::atomic<T>[capacity]) {}
+
+    T get(std::int64_t i) const noexcept {
+      return cells[i & mask].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t i, T value) noexcept {
+      cells[i & mask].store(value, std::memory_order_relaxed);
+    }
+
+    std::size_t mask;
+    std::unique_ptr<std::atomic<T>[]> cells;
+  };
+
+  static std::size_t round_up(std::size_t n) {
+    std::size_t res = 1;
+    while (res < n) {
+      res *= 2;
+    }
+    return res;
+  }
+
+  // Старые буферы могут еще читать воры, поэтому они живут до конца дека
+  ring* grow(ring* old, std::int64_t t, std::int64_t b) {
+    retired.push_back(std::make_unique<ring>((old->mask + 1) * 2));
+    ring* r = retired.back().get();
+    for (std::int64_t i = t; i < b; i++) {
+      r->put(i, old->get(i));
+    }
+    buffer.store(r, std::memory_order_release);
+    return r;
+  }
+
+  // top и bottom на разных строках кэша: bottom пишет только владелец
+  alignas(64) std::atomic<std::int64_t> top{0};
+  alignas(64) std::atomic<std::int64_t> bottom{0};
+  std::atomic<ring*> buffer{nullptr};
+  std::vector<std::unique_ptr<ring>> retired;
+};
@@ -1,7 +1,14 @@
+#include "atomic-shared-ptr.h"
 #include "shared-ptr.h"
 #include "tests-extra/test-object.h"
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
 template <typename T>
 struct custom_deleter {
   explicit custom_deleter(bool* deleted) : deleted(deleted) {}
@@ -261,3 +268,284 @@ TEST(shared_ptr_testing, conversions_inheritance) {
   shared_ptr<base> b = d;
   EXPECT_EQ(d.get(), b.get());
 }
+
+namespace {
+// test_object ведет учет в std::set и не годится для нескольких потоков
+struct counted {
+  explicit counted(std::int64_t value) : value(value) {
+    alive.fetch_add(1);
+  }
+
+  ~counted() {
+    alive.fetch_sub(1);
+  }
+
+  std::int64_t value;
+
+  static std::atomic<int> alive;
+};
+
+std::atomic<int> counted::alive{0};
+
+template <typename F>
+void run_threads(std::size_t n, F const& body) {
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < n; i++) {
+    threads.emplace_back([&body, i] { body(i); });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+} // namespace
+
+TEST(shared_ptr_testing, concurrent_copies) {
+  {
+    shared_ptr<counted> p = make_shared<counted>(42);
+    std::atomic<bool> broken{false};
+    run_threads(4, [&](std::size_t) {
+      for (int i = 0; i < 10000; i++) {
+        shared_ptr<counted> q = p;
+        weak_ptr<counted> w = q;
+        if (w.lock()->value != 42) {
+          broken.store(true);
+        }
+      }
+    });
+    EXPECT_FALSE(broken.load());
+    EXPECT_EQ(1, p.use_count());
+  }
+  EXPECT_EQ(0, counted::alive.load());
+}
+
+TEST(shared_ptr_testing, concurrent_last_release) {
+  for (int round = 0; round < 200; round++) {
+    std::vector<shared_ptr<counted>> owners(4,
+                                            shared_ptr<counted>(new counted(1)));
+    weak_ptr<counted> observer = owners[0];
+    std::atomic<bool> broken{false};
+    // владельцы отпускают объект, пока другие потоки пытаются его захватить
+    run_threads(8, [&](std::size_t i) {
+      if (i < owners.size()) {
+        owners[i].reset();
+      } else {
+        weak_ptr<counted> w = observer;
+        if (shared_ptr<counted> q = w.lock()) {
+          if (q->value != 1) {
+            broken.store(true);
+          }
+        }
+      }
+    });
+    EXPECT_FALSE(broken.load());
+    EXPECT_EQ(nullptr, observer.lock());
+    EXPECT_EQ(0, counted::alive.load());
+  }
+}
+
+TEST(local_shared_ptr_testing, copy_and_lock) {
+  test_object::no_new_instances_guard g;
+  local_weak_ptr<test_object> w;
+  {
+    local_shared_ptr<test_object> p = make_local_shared<test_object>(42);
+    local_shared_ptr<test_object> q = p;
+    w = q;
+    EXPECT_EQ(2, p.use_count());
+    EXPECT_EQ(42, *w.lock());
+  }
+  EXPECT_FALSE(w.lock());
+  g.expect_no_instances();
+}
+
+TEST(local_shared_ptr_testing, deleter_and_aliasing) {
+  bool deleted = false;
+  {
+    local_shared_ptr<test_object> p(new test_object(42),
+                                    custom_deleter<test_object>(&deleted));
+    local_shared_ptr<int> q(p, nullptr);
+    p.reset();
+    EXPECT_FALSE(deleted);
+    EXPECT_EQ(1, q.use_count());
+  }
+  EXPECT_TRUE(deleted);
+}
+
+TEST(atomic_shared_ptr_testing, load_store_exchange) {
+  test_object::no_new_instances_guard g;
+  {
+    atomic_shared_ptr<test_object> a;
+    EXPECT_TRUE(a.is_lock_free());
+    EXPECT_FALSE(a.load());
+
+    shared_ptr<test_object> p = make_shared<test_object>(1);
+    a.store(p);
+    EXPECT_EQ(p, a.load());
+    EXPECT_EQ(2, p.use_count());
+
+    shared_ptr<test_object> old = a.exchange(make_shared<test_object>(2));
+    EXPECT_EQ(p, old);
+    EXPECT_EQ(2, *a.load());
+    a = shared_ptr<test_object>();
+    EXPECT_FALSE(a.load());
+  }
+  g.expect_no_instances();
+}
+
+TEST(atomic_shared_ptr_testing, compare_exchange) {
+  test_object::no_new_instances_guard g;
+  {
+    shared_ptr<test_object> p = make_shared<test_object>(1);
+    atomic_shared_ptr<test_object> a(p);
+
+    shared_ptr<test_object> expected;
+    EXPECT_FALSE(
+        a.compare_exchange_strong(expected, make_shared<test_object>(2)));
+    EXPECT_EQ(p, expected);
+
+    // тот же объект, но другой блок управления
+    shared_ptr<test_object> alias(p.get(), [](test_object*) {});
+    EXPECT_FALSE(
+        a.compare_exchange_strong(alias, make_shared<test_object>(2)));
+    EXPECT_EQ(p, alias);
+    EXPECT_EQ(4, p.use_count());
+
+    EXPECT_TRUE(
+        a.compare_exchange_strong(expected, make_shared<test_object>(3)));
+    EXPECT_EQ(3, *a.load());
+    EXPECT_EQ(3, p.use_count());
+  }
+  g.expect_no_instances();
+}
+
+TEST(atomic_shared_ptr_testing, concurrent) {
+  {
+    atomic_shared_ptr<counted> a(make_shared<counted>(0));
+    std::atomic<bool> done{false};
+    std::atomic<bool> broken{false};
+    std::atomic<int> increments{0};
+    run_threads(6, [&](std::size_t i) {
+      if (i == 0) {
+        // поколение -- в старшей половине, CAS меняет только младшую,
+        // поэтому значение растет при любом чередовании писателей
+        for (std::int64_t v = 1; v <= 2000; v++) {
+          a.store(make_shared<counted>(v << 32));
+        }
+        done.store(true);
+      } else if (i == 1) {
+        // CAS-цикл поверх store: увеличивает счетчик внутри поколения
+        while (!done.load()) {
+          shared_ptr<counted> cur = a.load();
+          if (a.compare_exchange_weak(cur,
+                                      make_shared<counted>(cur->value + 1))) {
+            increments.fetch_add(1);
+          }
+        }
+      } else {
+        std::int64_t last = 0;
+        while (!done.load()) {
+          shared_ptr<counted> p = a.load();
+          if (p->value < last) {
+            broken.store(true);
+          }
+          last = p->value;
+        }
+      }
+    });
+    EXPECT_FALSE(broken.load());
+    EXPECT_EQ(1, a.load().use_count() - 1);
+  }
+  EXPECT_EQ(0, counted::alive.load());
+}
+
+namespace {
+struct pool_stats {
+  int allocations = 0;
+  int deallocations = 0;
+  int constructions = 0;
+};
+
+// Считает выделения; копии и rebind-копии пишут в один pool_stats
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  explicit counting_allocator(pool_stats* stats) : stats(stats) {}
+
+  template <typename U>
+  counting_allocator(counting_allocator<U> const& other) : stats(other.stats) {}
+
+  T* allocate(std::size_t n) {
+    ++stats->allocations;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    ++stats->deallocations;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ++stats->constructions;
+    new (p) U(std::forward<Args>(args)...);
+  }
+
+  pool_stats* stats;
+};
+
+struct point {
+  point(int x, int y, std::string name) : x(x), y(y), name(std::move(name)) {}
+
+  int x;
+  int y;
+  std::string name;
+};
+} // namespace
+
+TEST(shared_ptr_testing, make_shared_many_args) {
+  shared_ptr<point> p = make_shared<point>(1, 2, "a");
+  EXPECT_EQ(1, p->x);
+  EXPECT_EQ(2, p->y);
+  EXPECT_EQ("a", p->name);
+}
+
+TEST(shared_ptr_testing, allocate_shared) {
+  pool_stats stats;
+  {
+    shared_ptr<point> p =
+        allocate_shared<point>(counting_allocator<int>(&stats), 3, 4, "b");
+    weak_ptr<point> w = p;
+    EXPECT_EQ(4, p->y);
+    EXPECT_EQ(1, stats.allocations);
+    EXPECT_EQ(1, stats.constructions);
+    p.reset();
+    // объект уничтожен, блок держит weak_ptr
+    EXPECT_EQ(0, stats.deallocations);
+  }
+  EXPECT_EQ(1, stats.deallocations);
+}
+
+TEST(shared_ptr_testing, ptr_ctor_allocator) {
+  pool_stats stats;
+  bool deleted = false;
+  {
+    shared_ptr<test_object> p(new test_object(42),
+                              custom_deleter<test_object>(&deleted),
+                              counting_allocator<test_object>(&stats));
+    shared_ptr<test_object> q = p;
+    EXPECT_EQ(1, stats.allocations);
+  }
+  EXPECT_TRUE(deleted);
+  EXPECT_EQ(1, stats.deallocations);
+}
+
+TEST(local_shared_ptr_testing, allocate_local_shared) {
+  pool_stats stats;
+  {
+    local_shared_ptr<point> p = allocate_local_shared<point>(
+        counting_allocator<point>(&stats), 5, 6, "c");
+    EXPECT_EQ("c", p->name);
+  }
+  EXPECT_EQ(1, stats.allocations);
+  EXPECT_EQ(1, stats.deallocations);
+}
@@ -0,0 +1,109 @@
+#include "atomic-shared-ptr.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Чтение разделяемого снимка из 1..16 потоков, пока один поток раз в 10 мкс
+// публикует новый: atomic_shared_ptr, shared_ptr под мьютексом и
+// std::atomic<std::shared_ptr>. нс на load + уничтожение копии.
+namespace {
+template <typename T>
+void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using clock_type = std::chrono::steady_clock;
+
+double ns_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+constexpr std::size_t loads = 1'000'000;
+
+struct config {
+  int values[16];
+};
+
+struct ours {
+  atomic_shared_ptr<config> current{make_shared<config>()};
+
+  int read() const {
+    return current.load()->values[0];
+  }
+
+  void publish() {
+    current.store(make_shared<config>());
+  }
+};
+
+struct locked {
+  mutable std::mutex mutex;
+  shared_ptr<config> current = make_shared<config>();
+
+  int read() const {
+    shared_ptr<config> p;
+    {
+      std::lock_guard lock(mutex);
+      p = current;
+    }
+    return p->values[0];
+  }
+
+  void publish() {
+    shared_ptr<config> fresh = make_shared<config>();
+    std::lock_guard lock(mutex);
+    current = fresh;
+  }
+};
+
+struct standard {
+  std::atomic<std::shared_ptr<config>> current{std::make_shared<config>()};
+
+  int read() const {
+    return current.load()->values[0];
+  }
+
+  void publish() {
+    current.store(std::make_shared<config>());
+  }
+};
+
+template <typename Snapshot>
+double run(std::size_t readers) {
+  Snapshot snapshot;
+  std::atomic<std::size_t> running{readers};
+  std::vector<std::thread> threads;
+  auto start = clock_type::now();
+  for (std::size_t i = 0; i < readers; i++) {
+    threads.emplace_back([&] {
+      for (std::size_t j = 0; j < loads; j++) {
+        do_not_optimize(snapshot.read());
+      }
+      running.fetch_sub(1);
+    });
+  }
+  while (running.load() != 0) {
+    snapshot.publish();
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return ns_since(start) / loads;
+}
+} // namespace
+
+int main() {
+  std::printf("%8s %18s %18s %18s\n", "readers", "atomic_shared_ptr",
+              "mutex", "std::atomic<sp>");
+  for (std::size_t readers : {1, 2, 4, 8, 16}) {
+    std::printf("%8zu %18.1f %18.1f %18.1f\n", readers, run<ours>(readers),
+                run<locked>(readers), run<standard>(readers));
+  }
+}
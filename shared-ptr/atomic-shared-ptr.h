@@ -0,0 +1,171 @@
+#pragma once
+
+#include "shared-ptr.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+// shared_ptr, который можно читать и заменять из разных потоков.
+// Разделенный подсчет ссылок: текущее значение хранится в узле, слово
+// содержит указатель на узел (младшие 48 бит) и локальный счетчик читателей
+// (старшие 16 бит). load -- fetch_add на слове, копия shared_ptr из узла и
+// CAS, возвращающий локальную ссылку; блокировок нет. Заменивший узел
+// переносит оставшиеся локальные ссылки в refs узла, узел удаляет тот, кто
+// обнулил refs. Одновременных load не больше 2^16 - 1.
+template <typename T>
+class atomic_shared_ptr {
+public:
+  atomic_shared_ptr() noexcept = default;
+
+  atomic_shared_ptr(shared_ptr<T> desired)
+      : word(pack(make_node(std::move(desired)))) {}
+
+  atomic_shared_ptr(const atomic_shared_ptr&) = delete;
+  atomic_shared_ptr& operator=(const atomic_shared_ptr&) = delete;
+
+  // Операции к этому моменту должны завершиться
+  ~atomic_shared_ptr() {
+    delete unpack(word.load(std::memory_order_relaxed));
+  }
+
+  bool is_lock_free() const noexcept {
+    return word.is_lock_free();
+  }
+
+  shared_ptr<T> load() const {
+    node* n = acquire();
+    shared_ptr<T> res = n ? n->value : shared_ptr<T>();
+    release(n);
+    return res;
+  }
+
+  operator shared_ptr<T>() const {
+    return load();
+  }
+
+  void store(shared_ptr<T> desired) {
+    exchange(std::move(desired));
+  }
+
+  atomic_shared_ptr& operator=(shared_ptr<T> desired) {
+    store(std::move(desired));
+    return *this;
+  }
+
+  shared_ptr<T> exchange(shared_ptr<T> desired) {
+    std::uint64_t old = word.exchange(pack(make_node(std::move(desired))),
+                                      std::memory_order_acq_rel);
+    node* n = unpack(old);
+    if (!n) {
+      return shared_ptr<T>();
+    }
+    shared_ptr<T> res = n->value;
+    drop(n, local_count(old));
+    return res;
+  }
+
+  // Равенство -- тот же объект и тот же блок управления
+  bool compare_exchange_strong(shared_ptr<T>& expected,
+                               shared_ptr<T> desired) {
+    node* fresh = make_node(std::move(desired));
+    while (true) {
+      node* n = acquire();
+      if (!holds(n, expected)) {
+        expected = n ? n->value : shared_ptr<T>();
+        release(n);
+        delete fresh;
+        return false;
+      }
+      std::uint64_t cur = word.load(std::memory_order_relaxed);
+      while (unpack(cur) == n) {
+        if (word.compare_exchange_weak(cur, pack(fresh),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_relaxed)) {
+          // среди локальных ссылок -- и наша
+          if (n) {
+            drop(n, local_count(cur) - 1);
+          }
+          return true;
+        }
+      }
+      // узел заменили между acquire и CAS, сравниваем с новым
+      release(n);
+    }
+  }
+
+  bool compare_exchange_weak(shared_ptr<T>& expected, shared_ptr<T> desired) {
+    return compare_exchange_strong(expected, std::move(desired));
+  }
+
+private:
+  struct node {
+    explicit node(shared_ptr<T> value) : value(std::move(value)) {}
+
+    shared_ptr<T> value;
+    // ссылки читателей, перенесенные из слова, минус уже возвращенные
+    std::atomic<std::int64_t> refs{0};
+  };
+
+  static_assert(sizeof(void*) == 8, "needs 64-bit pointers");
+
+  static constexpr unsigned pointer_bits = 48;
+  static constexpr std::uint64_t one = std::uint64_t(1) << pointer_bits;
+  static constexpr std::uint64_t pointer_mask = one - 1;
+
+  static std::uint64_t pack(node* n) noexcept {
+    auto bits = reinterpret_cast<std::uintptr_t>(n);
+    assert((bits & ~pointer_mask) == 0);
+    return bits;
+  }
+
+  static node* unpack(std::uint64_t w) noexcept {
+    return reinterpret_cast<node*>(
+        static_cast<std::uintptr_t>(w & pointer_mask));
+  }
+
+  static std::int64_t local_count(std::uint64_t w) noexcept {
+    return static_cast<std::int64_t>(w >> pointer_bits);
+  }
+
+  // Пустой shared_ptr хранится без узла
+  static node* make_node(shared_ptr<T> value) {
+    return value.cb || value.ptr ? new node(std::move(value)) : nullptr;
+  }
+
+  static bool holds(node* n, shared_ptr<T> const& p) noexcept {
+    return n ? n->value.cb == p.cb && n->value.ptr == p.ptr
+             : !p.cb && !p.ptr;
+  }
+
+  // Удаляет узел, если после переноса transferred ссылок их не осталось
+  static void drop(node* n, std::int64_t transferred) {
+    if (n->refs.fetch_add(transferred, std::memory_order_acq_rel) +
+            transferred ==
+        0) {
+      delete n;
+    }
+  }
+
+  node* acquire() const noexcept {
+    return unpack(word.fetch_add(one, std::memory_order_acquire));
+  }
+
+  void release(node* n) const {
+    std::uint64_t cur = word.load(std::memory_order_relaxed);
+    while (unpack(cur) == n) {
+      if (word.compare_exchange_weak(cur, cur - one, std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    // узел сменился: заменивший перенес нашу ссылку в refs. Пока мы держим
+    // ссылку, узел не удален, и его адрес не может снова оказаться в слове
+    if (n) {
+      drop(n, -1);
+    }
+  }
+
+  mutable std::atomic<std::uint64_t> word{0};
+};
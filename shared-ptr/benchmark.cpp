@@ -0,0 +1,98 @@
+#include "shared-ptr.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Копирование и уничтожение shared_ptr на один объект из 1..16 потоков
+// (все RMW -- на одну кэш-линию счетчика) и на собственный объект каждого
+// потока. Сравнение с std::shared_ptr, нс на копию + уничтожение.
+// Отдельно -- в одном потоке, вместе с local_shared_ptr.
+namespace {
+template <typename T>
+void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using clock_type = std::chrono::steady_clock;
+
+double ns_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+constexpr std::size_t iterations = 1'000'000;
+
+// Каждый поток копирует ptrs[i], общее время делится на число копий в потоке
+template <typename Ptr>
+double run(std::vector<Ptr> const& ptrs) {
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (Ptr const& p : ptrs) {
+    threads.emplace_back([&] {
+      ready.fetch_add(1);
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (std::size_t i = 0; i < iterations; i++) {
+        Ptr copy = p;
+        do_not_optimize(copy.get());
+      }
+    });
+  }
+  while (ready.load() != ptrs.size()) {
+    std::this_thread::yield();
+  }
+  auto start = clock_type::now();
+  go.store(true);
+  for (auto& t : threads) {
+    t.join();
+  }
+  return ns_since(start) / iterations;
+}
+
+template <typename Ptr, typename Make>
+void run_row(char const* name, std::size_t threads, Make make) {
+  Ptr common = make();
+  std::vector<Ptr> shared(threads, common);
+  std::vector<Ptr> own;
+  for (std::size_t i = 0; i < threads; i++) {
+    own.push_back(make());
+  }
+  std::printf("%-18s %8zu %12.1f %12.1f\n", name, threads, run(shared),
+              run(own));
+}
+
+template <typename Ptr>
+double run_local(Ptr const& p) {
+  auto start = clock_type::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    Ptr copy = p;
+    do_not_optimize(copy.get());
+  }
+  return ns_since(start) / iterations;
+}
+} // namespace
+
+int main() {
+  std::printf("%-18s %8s %12s %12s\n", "ns/copy", "threads", "shared obj",
+              "own obj");
+  for (std::size_t threads : {1, 2, 4, 8, 16}) {
+    run_row<shared_ptr<int>>("shared_ptr", threads,
+                             [] { return make_shared<int>(1); });
+    run_row<std::shared_ptr<int>>("std::shared_ptr", threads,
+                                  [] { return std::make_shared<int>(1); });
+  }
+  // libstdc++ не использует атомарные операции, пока в программе не
+  // создан второй поток, поэтому замер после многопоточных
+  std::printf("\n%-18s %12s\n", "one thread", "ns/copy");
+  std::printf("%-18s %12.1f\n", "local_shared_ptr",
+              run_local(make_local_shared<int>(1)));
+  std::printf("%-18s %12.1f\n", "shared_ptr", run_local(make_shared<int>(1)));
+  std::printf("%-18s %12.1f\n", "std::shared_ptr",
+              run_local(std::make_shared<int>(1)));
+}
@@ -1,30 +1,39 @@
 #include "shared-ptr.h"
 
-size_t control_block::control_block::use_count() {
-  return strong_ref;
+template <typename Count>
+size_t control_block::control_block<Count>::use_count() {
+  return Count::load(strong_ref);
 }
 
-void control_block::control_block::strong_inc() {
-  ++strong_ref;
+template <typename Count>
+void control_block::control_block<Count>::strong_inc() {
+  Count::inc(strong_ref);
 }
 
-void control_block::control_block::strong_dec() {
-  --strong_ref;
-  if (strong_ref == 0) {
+template <typename Count>
+bool control_block::control_block<Count>::strong_inc_nonzero() {
+  return Count::inc_nonzero(strong_ref);
+}
+
+template <typename Count>
+void control_block::control_block<Count>::strong_dec() {
+  if (Count::dec(strong_ref)) {
     destroy();
-  }
-  if (strong_ref + weak_ref == 0) {
-    delete this;
+    weak_dec();
   }
 }
 
-void control_block::control_block::weak_inc() {
-  ++weak_ref;
+template <typename Count>
+void control_block::control_block<Count>::weak_inc() {
+  Count::inc(weak_ref);
 }
 
-void control_block::control_block::weak_dec() {
-  --weak_ref;
-  if (strong_ref + weak_ref == 0) {
-    delete this;
+template <typename Count>
+void control_block::control_block<Count>::weak_dec() {
+  if (Count::dec(weak_ref)) {
+    destroy_block();
   }
 }
+
+template class control_block::control_block<control_block::atomic_count>;
+template class control_block::control_block<control_block::local_count>;
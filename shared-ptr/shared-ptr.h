@@ -1,32 +1,129 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <utility>
 
 namespace control_block {
+// Политики счетчиков ссылок. atomic_count -- ссылки на один объект можно
+// копировать и уничтожать из разных потоков, local_count -- обычные целые
+// для объектов, которые не покидают свой поток
+struct atomic_count {
+  using type = std::atomic<size_t>;
+
+  static size_t load(type const& count) noexcept {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  // Новая ссылка копируется из существующей, которая держит блок, поэтому
+  // упорядочивание не нужно
+  static void inc(type& count) noexcept {
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static bool inc_nonzero(type& count) noexcept {
+    size_t value = count.load(std::memory_order_relaxed);
+    while (value != 0) {
+      if (count.compare_exchange_weak(value, value + 1,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // true, если ссылка была последней. acq_rel: записи в объект из всех
+  // потоков видны до его уничтожения
+  static bool dec(type& count) noexcept {
+    return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+};
+
+struct local_count {
+  using type = size_t;
+
+  static size_t load(type const& count) noexcept {
+    return count;
+  }
+
+  static void inc(type& count) noexcept {
+    ++count;
+  }
+
+  static bool inc_nonzero(type& count) noexcept {
+    return count != 0 && ++count;
+  }
+
+  static bool dec(type& count) noexcept {
+    return --count == 0;
+  }
+};
+
+// Пока strong_ref > 0, все сильные ссылки вместе держат одну слабую, поэтому
+// последняя сильная ссылка освобождает блок одним weak_dec, а не проверкой
+// обоих счетчиков
+template <typename Count>
 class control_block {
 private:
-  size_t strong_ref = 1;
-  size_t weak_ref = 0;
+  typename Count::type strong_ref{1};
+  typename Count::type weak_ref{1};
 
 protected:
   virtual ~control_block() = default;
+  // уничтожает объект
   virtual void destroy() = 0;
+  // уничтожает и освобождает сам блок тем же аллокатором, что его выделил
+  virtual void destroy_block() = 0;
 
 public:
   size_t use_count();
 
   void strong_inc();
+  // strong_inc, если объект еще жив
+  bool strong_inc_nonzero();
   void strong_dec();
   void weak_inc();
   void weak_dec();
 };
 
-template <typename T, typename D>
-class ptr_block : public control_block, private D {
+extern template class control_block<atomic_count>;
+extern template class control_block<local_count>;
+
+template <typename Block, typename Alloc>
+using block_alloc_t =
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+
+// Выделяет блок через Alloc, блок хранит копию аллокатора для destroy_block
+template <typename Block, typename Alloc, typename... Args>
+Block* create_block(Alloc const& alloc, Args&&... args) {
+  using traits = std::allocator_traits<block_alloc_t<Block, Alloc>>;
+  block_alloc_t<Block, Alloc> a(alloc);
+  Block* block = traits::allocate(a, 1);
+  try {
+    new (block) Block(a, std::forward<Args>(args)...);
+  } catch (...) {
+    traits::deallocate(a, block, 1);
+    throw;
+  }
+  return block;
+}
+
+template <typename Block, typename Alloc>
+void free_block(Block* block, Alloc const& alloc) noexcept {
+  using traits = std::allocator_traits<block_alloc_t<Block, Alloc>>;
+  block_alloc_t<Block, Alloc> a(alloc);
+  block->~Block();
+  traits::deallocate(a, block, 1);
+}
+
+template <typename T, typename D, typename Count, typename Alloc>
+class ptr_block : public control_block<Count>, private D {
 private:
+  using alloc_t = block_alloc_t<ptr_block, Alloc>;
+
   T* ptr;
+  [[no_unique_address]] alloc_t alloc;
 
 protected:
   void destroy() override {
@@ -35,20 +132,37 @@ protected:
     }
   }
 
+  void destroy_block() override {
+    free_block(this, alloc);
+  }
+
 public:
-  ptr_block(T* o_ptr, D deleter) : ptr(o_ptr), D(std::move(deleter)) {}
+  ptr_block(alloc_t const& alloc, T* o_ptr, D deleter)
+      : D(std::move(deleter)), ptr(o_ptr), alloc(alloc) {}
 };
 
-template <typename T>
-class obj_block : public control_block {
+template <typename T, typename Count, typename Alloc>
+class obj_block : public control_block<Count> {
+private:
+  using alloc_t = block_alloc_t<obj_block, Alloc>;
+  using obj_alloc_t = block_alloc_t<T, Alloc>;
+  using obj_traits = std::allocator_traits<obj_alloc_t>;
+
 public:
+  // Объект создается через construct аллокатора, как в std::allocate_shared
   template <typename... Args>
-  obj_block(Args&&... args) {
-    new (&obj) T(std::forward<Args...>(args)...);
+  obj_block(alloc_t const& alloc, Args&&... args) : alloc(alloc) {
+    obj_alloc_t a(alloc);
+    obj_traits::construct(a, get_obj(), std::forward<Args>(args)...);
   }
 
   void destroy() override {
-    get_obj()->~T();
+    obj_alloc_t a(alloc);
+    obj_traits::destroy(a, get_obj());
+  }
+
+  void destroy_block() override {
+    free_block(this, alloc);
   }
 
   T* get_obj() {
@@ -57,21 +171,34 @@ public:
 
 private:
   std::aligned_storage_t<sizeof(T), alignof(T)> obj;
+  [[no_unique_address]] alloc_t alloc;
 };
 } // namespace control_block
 
-template <typename T>
-class shared_ptr {
+template <typename T, typename Count>
+class basic_weak_ptr;
+
+template <typename T, typename Count>
+class basic_shared_ptr {
 public:
-  shared_ptr() noexcept : cb(nullptr), ptr(nullptr) {}
+  basic_shared_ptr() noexcept : cb(nullptr), ptr(nullptr) {}
 
-  shared_ptr(std::nullptr_t) noexcept : shared_ptr() {}
+  basic_shared_ptr(std::nullptr_t) noexcept : basic_shared_ptr() {}
 
   template <typename V, typename D = std::default_delete<V>>
-  shared_ptr(V* o_ptr, D&& deleter = std::default_delete<V>())
+  basic_shared_ptr(V* o_ptr, D&& deleter = std::default_delete<V>())
+      : basic_shared_ptr(o_ptr, std::forward<D>(deleter),
+                         std::allocator<V>()) {}
+
+  // Блок управления выделяется через alloc и освобождается им же
+  template <typename V, typename D, typename Alloc>
+  basic_shared_ptr(V* o_ptr, D&& deleter, Alloc const& alloc)
       : ptr(static_cast<T*>(o_ptr)) {
+    using block_t =
+        control_block::ptr_block<V, std::decay_t<D>, Count, Alloc>;
     try {
-      cb = new control_block::ptr_block<V, D>(o_ptr, std::forward<D>(deleter));
+      cb = control_block::create_block<block_t>(alloc, o_ptr,
+                                                std::forward<D>(deleter));
     } catch (...) {
       deleter(o_ptr);
       cb = nullptr;
@@ -81,55 +208,58 @@ public:
   }
 
   template <typename V>
-  shared_ptr(const shared_ptr<V>& other) noexcept
+  basic_shared_ptr(const basic_shared_ptr<V, Count>& other) noexcept
       : cb(other.cb), ptr(static_cast<T*>(other.ptr)) {
     inc();
   }
 
-  shared_ptr(const shared_ptr& other) noexcept : cb(other.cb), ptr(other.ptr) {
+  basic_shared_ptr(const basic_shared_ptr& other) noexcept
+      : cb(other.cb), ptr(other.ptr) {
     inc();
   }
 
-  shared_ptr(shared_ptr&& other) noexcept : cb(other.cb), ptr(other.ptr) {
+  basic_shared_ptr(basic_shared_ptr&& other) noexcept
+      : cb(other.cb), ptr(other.ptr) {
     other.cb = nullptr;
     other.ptr = nullptr;
   }
 
   template <typename V>
-  shared_ptr(const shared_ptr<V>& other, T* o_ptr) noexcept
+  basic_shared_ptr(const basic_shared_ptr<V, Count>& other, T* o_ptr) noexcept
       : cb(other.cb), ptr(o_ptr) {
     inc();
   }
 
-  ~shared_ptr() {
+  ~basic_shared_ptr() {
     dec();
   }
 
   template <typename V>
-  shared_ptr& operator=(const shared_ptr<V>& other) noexcept {
-    shared_ptr new_ptr(other);
+  basic_shared_ptr&
+  operator=(const basic_shared_ptr<V, Count>& other) noexcept {
+    basic_shared_ptr new_ptr(other);
     swap(new_ptr);
     return *this;
   }
 
-  shared_ptr& operator=(const shared_ptr& other) noexcept {
-    if (other != *this) {
-      shared_ptr new_ptr(other);
+  basic_shared_ptr& operator=(const basic_shared_ptr& other) noexcept {
+    if (&other != this) {
+      basic_shared_ptr new_ptr(other);
       swap(new_ptr);
     }
     return *this;
   }
 
   template <typename V>
-  shared_ptr& operator=(shared_ptr<V>&& other) noexcept {
-    shared_ptr new_ptr(std::move(other));
+  basic_shared_ptr& operator=(basic_shared_ptr<V, Count>&& other) noexcept {
+    basic_shared_ptr new_ptr(std::move(other));
     swap(new_ptr);
     return *this;
   }
 
-  shared_ptr& operator=(shared_ptr&& other) noexcept {
-    if (other != *this) {
-      shared_ptr new_ptr(std::move(other));
+  basic_shared_ptr& operator=(basic_shared_ptr&& other) noexcept {
+    if (&other != this) {
+      basic_shared_ptr new_ptr(std::move(other));
       swap(new_ptr);
     }
     return *this;
@@ -165,26 +295,31 @@ public:
 
   template <typename V, typename D = std::default_delete<V>>
   void reset(V* new_ptr, D&& deleter = std::default_delete<V>()) {
-    *this = shared_ptr(new_ptr, std::forward<D>(deleter));
+    *this = basic_shared_ptr(new_ptr, std::forward<D>(deleter));
   }
 
-  friend bool operator==(const shared_ptr& lhs, const shared_ptr& rhs) {
+  friend bool operator==(const basic_shared_ptr& lhs,
+                         const basic_shared_ptr& rhs) {
     return lhs.get() == rhs.get();
   }
-  friend bool operator!=(const shared_ptr& lhs, const shared_ptr& rhs) {
+  friend bool operator!=(const basic_shared_ptr& lhs,
+                         const basic_shared_ptr& rhs) {
     return lhs.get() != rhs.get();
   }
 
 private:
-  control_block::control_block* cb;
+  control_block::control_block<Count>* cb;
   T* ptr;
 
+  template <typename V, typename C>
+  friend class basic_shared_ptr;
+  template <typename V, typename C>
+  friend class basic_weak_ptr;
   template <typename V>
-  friend class shared_ptr;
-  template <typename V>
-  friend class weak_ptr;
-  template <typename V, typename... Args>
-  friend shared_ptr<V> make_shared(Args&&...);
+  friend class atomic_shared_ptr;
+  template <typename V, typename C, typename Alloc, typename... Args>
+  friend basic_shared_ptr<V, C> allocate_basic_shared(Alloc const&,
+                                                      Args&&...);
 
   void inc() {
     if (cb) {
@@ -198,71 +333,73 @@ private:
     }
   }
 
-  shared_ptr(control_block::control_block* o_cb, T* o_ptr)
+  basic_shared_ptr(control_block::control_block<Count>* o_cb, T* o_ptr)
       : cb(o_cb), ptr(o_ptr) {}
 
   template <typename V>
-  void swap(shared_ptr<V>& other) {
+  void swap(basic_shared_ptr<V, Count>& other) {
     std::swap(cb, other.cb);
     std::swap(ptr, other.ptr);
   }
 };
 
-template <typename T>
-class weak_ptr {
+template <typename T, typename Count>
+class basic_weak_ptr {
 public:
-  weak_ptr() noexcept : cb(nullptr), ptr(nullptr) {}
+  basic_weak_ptr() noexcept : cb(nullptr), ptr(nullptr) {}
 
-  weak_ptr(const weak_ptr<T>& other) noexcept : cb(other.cb), ptr(other.ptr) {
+  basic_weak_ptr(const basic_weak_ptr& other) noexcept
+      : cb(other.cb), ptr(other.ptr) {
     inc();
   }
 
-  weak_ptr(weak_ptr<T>&& other) noexcept : cb(other.cb), ptr(other.ptr) {
+  basic_weak_ptr(basic_weak_ptr&& other) noexcept
+      : cb(other.cb), ptr(other.ptr) {
     other.cb = nullptr;
     other.ptr = nullptr;
   }
 
-  weak_ptr(const shared_ptr<T>& other) noexcept : cb(other.cb), ptr(other.ptr) {
+  basic_weak_ptr(const basic_shared_ptr<T, Count>& other) noexcept
+      : cb(other.cb), ptr(other.ptr) {
     inc();
   }
 
-  ~weak_ptr() {
+  ~basic_weak_ptr() {
     dec();
   }
 
-  weak_ptr& operator=(const shared_ptr<T>& other) noexcept {
-    weak_ptr new_ptr(other);
+  basic_weak_ptr& operator=(const basic_shared_ptr<T, Count>& other) noexcept {
+    basic_weak_ptr new_ptr(other);
     swap(new_ptr);
     return *this;
   }
 
-  weak_ptr& operator=(const weak_ptr<T>& other) noexcept {
-    weak_ptr new_ptr(other);
+  basic_weak_ptr& operator=(const basic_weak_ptr& other) noexcept {
+    basic_weak_ptr new_ptr(other);
     swap(new_ptr);
     return *this;
   }
 
-  weak_ptr& operator=(weak_ptr<T>&& other) noexcept {
-    weak_ptr new_ptr(std::move(other));
+  basic_weak_ptr& operator=(basic_weak_ptr&& other) noexcept {
+    basic_weak_ptr new_ptr(std::move(other));
     swap(new_ptr);
     return *this;
   }
 
-  shared_ptr<T> lock() const noexcept {
-    if (!cb || cb->use_count() == 0) {
-      return shared_ptr<T>();
+  basic_shared_ptr<T, Count> lock() const noexcept {
+    if (!cb || !cb->strong_inc_nonzero()) {
+      return basic_shared_ptr<T, Count>();
     }
-    cb->strong_inc();
-    return shared_ptr<T>(cb, ptr);
+    return basic_shared_ptr<T, Count>(cb, ptr);
   }
 
-  void swap(weak_ptr& other) {
+  void swap(basic_weak_ptr& other) {
     std::swap(cb, other.cb);
     std::swap(ptr, other.ptr);
   }
 
 private:
-  control_block::control_block* cb;
+  control_block::control_block<Count>* cb;
   T* ptr;
 
   void inc() {
@@ -278,9 +415,51 @@ private:
   }
 };
 
+// Объект и блок управления -- одно выделение через alloc
+template <typename T, typename Count, typename Alloc, typename... Args>
+basic_shared_ptr<T, Count> allocate_basic_shared(Alloc const& alloc,
+                                                 Args&&... args) {
+  using block_t = control_block::obj_block<T, Count, Alloc>;
+  auto* cb =
+      control_block::create_block<block_t>(alloc, std::forward<Args>(args)...);
+  return basic_shared_ptr<T, Count>(
+      static_cast<control_block::control_block<Count>*>(cb), cb->get_obj());
+}
+
+template <typename T>
+using shared_ptr = basic_shared_ptr<T, control_block::atomic_count>;
+
+template <typename T>
+using weak_ptr = basic_weak_ptr<T, control_block::atomic_count>;
+
+// Для объектов одного потока: копирование и уничтожение без атомарных
+// операций, передавать в другой поток нельзя
+template <typename T>
+using local_shared_ptr = basic_shared_ptr<T, control_block::local_count>;
+
+template <typename T>
+using local_weak_ptr = basic_weak_ptr<T, control_block::local_count>;
+
+template <typename T, typename Alloc, typename... Args>
+shared_ptr<T> allocate_shared(Alloc const& alloc, Args&&... args) {
+  return allocate_basic_shared<T, control_block::atomic_count>(
+      alloc, std::forward<Args>(args)...);
+}
+
 template <typename T, typename... Args>
 shared_ptr<T> make_shared(Args&&... args) {
-  auto* cb = new control_block::obj_block<T>(std::forward<Args...>(args)...);
-  return shared_ptr<T>(static_cast<control_block::control_block*>(cb),
-                       cb->get_obj());
+  return ::allocate_shared<T>(std::allocator<T>(),
+                              std::forward<Args>(args)...);
+}
+
+template <typename T, typename Alloc, typename... Args>
+local_shared_ptr<T> allocate_local_shared(Alloc const& alloc, Args&&... args) {
+  return allocate_basic_shared<T, control_block::local_count>(
+      alloc, std::forward<Args>(args)...);
+}
+
+template <typename T, typename... Args>
+local_shared_ptr<T> make_local_shared(Args&&... args) {
+  return allocate_local_shared<T>(std::allocator<T>(),
+                                  std::forward<Args>(args)...);
 }
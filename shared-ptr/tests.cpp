@@ -247,8 +247,9 @@ TEST(shared_ptr_testing, make_shared_weak_ptr) {
 
 #ifndef DISABLE_ALLOCATION_TESTS
 namespace {
-size_t new_calls = 0;
-size_t delete_calls = 0;
+// по потокам: в других тестах объекты создаются и удаляются параллельно
+thread_local size_t new_calls = 0;
+thread_local size_t delete_calls = 0;
 } // namespace
 void* operator new(std::size_t count) {
   new_calls += 1;